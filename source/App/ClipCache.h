@@ -0,0 +1,302 @@
+#pragma once
+#include <JuceHeader.h>
+#include <list>
+#include <tuple>
+#include <map>
+#include <future>
+#include <functional>
+
+// Decoded audio files shared by every source that plays them. A clip is decoded once
+// and converted to the rate it is played at; sources keep it alive while they hold it.
+// Clips nobody holds stay cached until the memory budget is exceeded, then the least
+// recently used ones are dropped first.
+class ClipCache
+{
+public:
+    // how clips are kept in memory, packed clips are converted back to float a block
+    // at a time while they play
+    enum class Storage
+    {
+        float32,
+        // half and a quarter less memory, 96 and 144 dB of dynamic range
+        int16,
+        int24
+    };
+    class Clip
+    {
+    public:
+        Clip(juce::AudioBuffer<float> &&decoded, Storage s, double rate, double source_rate)
+            : sample_rate(rate), source_sample_rate(source_rate), storage(s),
+              channels(decoded.getNumChannels()), length(decoded.getNumSamples())
+        {
+            if (storage == Storage::float32)
+            {
+                audio = std::move(decoded);
+                return;
+            }
+            packed.resize((size_t)channels * length * width());
+            for (int c = 0; c < channels; c++)
+                pack(decoded.getReadPointer(c), packed.data() + (size_t)c * length * width());
+        }
+        int getNumSamples() const
+        {
+            return length;
+        }
+        int getNumChannels() const
+        {
+            return channels;
+        }
+        size_t bytes() const
+        {
+            return storage == Storage::float32 ? (size_t)channels * length * sizeof(float) : packed.size();
+        }
+        // converts the n samples of a channel from the given position into dest
+        void read(int channel, int from, float *dest, int n) const
+        {
+            if (storage == Storage::float32)
+            {
+                juce::FloatVectorOperations::copy(dest, audio.getReadPointer(channel, from), n);
+                return;
+            }
+            auto src = packed.data() + ((size_t)channel * length + from) * width();
+            if (storage == Storage::int16)
+            {
+                // a plain loop over contiguous samples, the compiler vectorises it
+                auto samples = (const int16_t *)src;
+                for (int i = 0; i < n; i++)
+                    dest[i] = samples[i] * (1.0f / 32767.0f);
+                return;
+            }
+            for (int i = 0; i < n; i++, src += 3)
+                dest[i] = (int32_t)(((uint32_t)src[0] << 8) | ((uint32_t)src[1] << 16) | ((uint32_t)src[2] << 24)) * (1.0f / (8388607.0f * 256.0f));
+        }
+        double sample_rate;
+        // at the file's own rate, for the length of the clip in seconds
+        double source_sample_rate;
+
+    private:
+        Storage storage;
+        int channels;
+        int length;
+        juce::AudioBuffer<float> audio;
+        // channel after channel, little endian
+        std::vector<uint8_t> packed;
+
+        int width() const
+        {
+            return storage == Storage::int16 ? 2 : 3;
+        }
+        void pack(const float *samples, uint8_t *to)
+        {
+            if (storage == Storage::int16)
+            {
+                auto out = (int16_t *)to;
+                for (int i = 0; i < length; i++)
+                    out[i] = (int16_t)juce::roundToInt(juce::jlimit(-1.0f, 1.0f, samples[i]) * 32767.0f);
+                return;
+            }
+            for (int i = 0; i < length; i++, to += 3)
+            {
+                int32_t v = juce::roundToInt(juce::jlimit(-1.0f, 1.0f, samples[i]) * 8388607.0f);
+                to[0] = (uint8_t)v;
+                to[1] = (uint8_t)(v >> 8);
+                to[2] = (uint8_t)(v >> 16);
+            }
+        }
+    };
+    static ClipCache &getInstance()
+    {
+        static ClipCache instance;
+        return instance;
+    }
+    // the clip of the file at the given rate, decoded unless it is cached,
+    // nullptr when the file can't be read. Different files are decoded in parallel
+    // when called from several threads, a file already being decoded is waited for.
+    // Throws what decoding throws, bad_alloc for a file too large to decode.
+    std::shared_ptr<const Clip> get(const juce::File &file, double sample_rate)
+    {
+        std::promise<std::shared_ptr<const Clip>> decoded;
+        Key key;
+        // setStorage may change it while the file is decoded, the clip is filed under this one
+        Storage s;
+        {
+            const juce::ScopedLock lock(mutex);
+            s = storage;
+            key = {file.getFullPathName().toStdString(), file.getLastModificationTime().toMilliseconds(), sample_rate, s};
+            auto it = index.find(key);
+            if (it != index.end())
+            {
+                // most recently used clips are at the front
+                entries.splice(entries.begin(), entries, it->second);
+                return it->second->clip;
+            }
+            auto p = pending.find(key);
+            if (p != pending.end())
+            {
+                auto other = p->second;
+                const juce::ScopedUnlock unlock(mutex);
+                return other.get();
+            }
+            pending[key] = decoded.get_future().share();
+        }
+        std::shared_ptr<const Clip> clip;
+        try
+        {
+            clip = decode(file, sample_rate, s);
+        }
+        catch (...)
+        {
+            // the threads waiting for this decode get the error too, a later get tries again
+            {
+                const juce::ScopedLock lock(mutex);
+                pending.erase(key);
+            }
+            decoded.set_exception(std::current_exception());
+            throw;
+        }
+        {
+            const juce::ScopedLock lock(mutex);
+            pending.erase(key);
+            if (clip != nullptr)
+            {
+                entries.push_front({key, clip});
+                index[key] = entries.begin();
+                used += clip->bytes();
+                evict();
+            }
+        }
+        decoded.set_value(clip);
+        return clip;
+    }
+    // the clip if it is cached, nullptr otherwise, never decodes
+    std::shared_ptr<const Clip> find(const juce::File &file, double sample_rate)
+    {
+        const juce::ScopedLock lock(mutex);
+        auto it = index.find({file.getFullPathName().toStdString(), file.getLastModificationTime().toMilliseconds(), sample_rate, storage});
+        if (it == index.end())
+            return nullptr;
+        entries.splice(entries.begin(), entries, it->second);
+        return it->second->clip;
+    }
+    // decodes the clip on a background thread unless it is cached, done is called there
+    void decodeAsync(const juce::File &file, double sample_rate, std::function<void(std::shared_ptr<const Clip>)> done)
+    {
+        decoding.addJob([this, file, sample_rate, done]()
+                        {
+                            std::shared_ptr<const Clip> clip;
+                            try
+                            {
+                                clip = get(file, sample_rate);
+                            }
+                            catch (...)
+                            {
+                                // played as silence, like a file that can't be read
+                            }
+                            done(clip); });
+    }
+    // whether a file of this size would be kept in the cache at all
+    bool fits(juce::int64 samples, int channels)
+    {
+        const juce::ScopedLock lock(mutex);
+        size_t width = storage == Storage::float32 ? sizeof(float) : storage == Storage::int16 ? 2 : 3;
+        return (size_t)samples * channels * width <= budget;
+    }
+    // applies to clips decoded from now on, cached clips keep their storage
+    void setStorage(Storage s)
+    {
+        const juce::ScopedLock lock(mutex);
+        storage = s;
+    }
+    Storage getStorage()
+    {
+        const juce::ScopedLock lock(mutex);
+        return storage;
+    }
+    void setBudget(size_t b)
+    {
+        const juce::ScopedLock lock(mutex);
+        budget = b;
+        evict();
+    }
+    size_t getBudget()
+    {
+        const juce::ScopedLock lock(mutex);
+        return budget;
+    }
+    size_t getUsed()
+    {
+        const juce::ScopedLock lock(mutex);
+        return used;
+    }
+
+private:
+    ClipCache()
+    {
+        formatManager.registerBasicFormats();
+    }
+    struct Key
+    {
+        std::string path;
+        juce::int64 modified;
+        double sample_rate;
+        Storage storage;
+        bool operator<(const Key &other) const
+        {
+            return std::tie(path, modified, sample_rate, storage) < std::tie(other.path, other.modified, other.sample_rate, other.storage);
+        }
+    };
+    struct Entry
+    {
+        Key key;
+        std::shared_ptr<const Clip> clip;
+    };
+    // drops the least recently used clips until the cache fits, clips still held by
+    // a source can't be freed, so they stay and keep counting
+    void evict()
+    {
+        for (auto it = entries.end(); used > budget && it != entries.begin();)
+        {
+            --it;
+            if (it->clip.use_count() > 1)
+                continue;
+            used -= it->clip->bytes();
+            index.erase(it->key);
+            it = entries.erase(it);
+        }
+    }
+    std::shared_ptr<const Clip> decode(const juce::File &file, double sample_rate, Storage s)
+    {
+        std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(file));
+        if (reader == nullptr || reader->lengthInSamples <= 0 || reader->sampleRate <= 0)
+            return nullptr;
+        int channels = juce::jlimit(1, 2, (int)reader->numChannels);
+        int length = (int)reader->lengthInSamples;
+        juce::AudioBuffer<float> decoded(channels, length);
+        reader->read(&decoded, 0, length, 0, true, channels > 1);
+
+        double ratio = reader->sampleRate / sample_rate;
+        if (ratio == 1.0)
+            return std::make_shared<Clip>(std::move(decoded), s, sample_rate, reader->sampleRate);
+        // converted once here instead of on every block by every reader
+        int converted = (int)(length / ratio);
+        juce::AudioBuffer<float> resampled(channels, converted);
+        for (int c = 0; c < channels; c++)
+        {
+            juce::LagrangeInterpolator interpolator;
+            interpolator.process(ratio, decoded.getReadPointer(c), resampled.getWritePointer(c), converted, length, 0);
+        }
+        return std::make_shared<Clip>(std::move(resampled), s, sample_rate, reader->sampleRate);
+    }
+
+    juce::CriticalSection mutex;
+    // shared by the decoding threads, creating a reader only reads it
+    juce::AudioFormatManager formatManager;
+    std::list<Entry> entries;
+    std::map<Key, std::list<Entry>::iterator> index;
+    std::map<Key, std::shared_future<std::shared_ptr<const Clip>>> pending;
+    size_t used = 0;
+    size_t budget = (size_t)512 * 1024 * 1024;
+    Storage storage = Storage::float32;
+    // last, so pending decodes finish before the cache goes away
+    juce::ThreadPool decoding{2};
+};
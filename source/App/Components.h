@@ -27,6 +27,8 @@ public:
         ((IntRef *)(value_ref))->value = v;
         update();
         listener->comboBoxChanged(c);
+        if (onChange != nullptr)
+            onChange();
     }
     void update() override
     {
@@ -117,6 +119,8 @@ public:
         strref->value = name.toStdString();
         label.setText(name, juce::NotificationType::dontSendNotification);
         listener->fileChanged();
+        if (onChange != nullptr)
+            onChange();
     }
     void update() override
     {
@@ -146,6 +150,8 @@ public:
     {
         *value = slider->getValue();
         listener->valueChanged();
+        if (onChange != nullptr)
+            onChange();
     }
     NumberInput(NumberInput::Listener *_node, float min, float max, FloatRef *val) : ValueRefComponent(val)
     {
@@ -1,17 +1,378 @@
 #pragma once
 #include <JuceHeader.h>
+#include <array>
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define FASTMATH_SSE2 1
+#endif
+
+// The waveforms sample by sample, as defined with std::fmod. F::get and the exact block
+// versions use these.
+struct ExactMath
+{
+    static double square(double x)
+    {
+        x = std::fmod(x, 2.0f * juce::MathConstants<double>::pi);
+        return x > juce::MathConstants<double>::pi ? -1.0 : 1.0;
+    }
+    static double sawtooth(double x)
+    {
+        x = std::fmod(x, 2.0f * juce::MathConstants<double>::pi);
+        if (x > juce::MathConstants<double>::pi)
+            return juce::jmap(x, juce::MathConstants<double>::pi, 2.0f * juce::MathConstants<double>::pi, -1.0, 0.0);
+        else
+            return juce::jmap(x, 0.0, juce::MathConstants<double>::pi, 0.0, 1.0);
+    }
+    static double triangle(double x)
+    {
+        x = x + juce::MathConstants<double>::pi / 2.0;
+        x = std::fmod(x, 2.0f * juce::MathConstants<double>::pi) - juce::MathConstants<double>::pi;
+        return (x < 0) ? juce::jmap(x, -juce::MathConstants<double>::pi, 0.0, -1.0, 1.0)
+                       : juce::jmap(x, 0.0, juce::MathConstants<double>::pi, 1.0, -1.0);
+    }
+    static double line(double x, double start, double end)
+    {
+        x = std::fmod(x, juce::MathConstants<double>::twoPi);
+        return juce::jmap(x, 0.0, juce::MathConstants<double>::twoPi, start, end);
+    }
+};
+
+// Block versions of the waveforms for processBlock and FunctionProgram. Every function
+// has a branch-free approximation of std::sin and std::fmod that runs two samples per
+// SSE2 instruction, each one can be turned off on its own and then gives what ExactMath
+// gives. Without SSE2 the approximations run sample by sample with the same results.
+struct FastMath
+{
+    enum Function
+    {
+        Sin,
+        Square,
+        Sawtooth,
+        Triangle,
+        Line,
+        Wrap,
+        count
+    };
+    static inline std::array<bool, count> enabled{true, true, true, true, true, true};
+
+    // absolute error below 1e-7
+    static void sin(const double *x, double *out, int n)
+    {
+        if (enabled[Sin])
+            map(x, out, n, [](auto v) { return sin(v); });
+        else
+            for (int i = 0; i < n; i++)
+                out[i] = std::sin(x[i]);
+    }
+    static void square(const double *x, double *out, int n)
+    {
+        if (enabled[Square])
+            map(x, out, n, [](auto v) { return square(v); });
+        else
+            for (int i = 0; i < n; i++)
+                out[i] = ExactMath::square(x[i]);
+    }
+    static void sawtooth(const double *x, double *out, int n)
+    {
+        if (enabled[Sawtooth])
+            map(x, out, n, [](auto v) { return sawtooth(v); });
+        else
+            for (int i = 0; i < n; i++)
+                out[i] = ExactMath::sawtooth(x[i]);
+    }
+    static void triangle(const double *x, double *out, int n)
+    {
+        if (enabled[Triangle])
+            map(x, out, n, [](auto v) { return triangle(v); });
+        else
+            for (int i = 0; i < n; i++)
+                out[i] = ExactMath::triangle(x[i]);
+    }
+    static void line(const double *x, double *out, int n, double start, double end)
+    {
+        const double twoPi = juce::MathConstants<double>::twoPi;
+        double slope = (end - start) / twoPi;
+        if (enabled[Line])
+            map(x, out, n, [=](auto v) { return start + slope * wrap(v, twoPi); });
+        else
+            for (int i = 0; i < n; i++)
+                out[i] = ExactMath::line(x[i], start, end);
+    }
+    // fmod for a positive period
+    static void wrap(const double *x, double *out, int n, double period)
+    {
+        if (enabled[Wrap])
+            map(x, out, n, [=](auto v) { return wrap(v, period); });
+        else
+            for (int i = 0; i < n; i++)
+                out[i] = std::fmod(x[i], period);
+    }
+    static void divide(const double *a, const double *b, double *out, int n)
+    {
+        int i = 0;
+#if FASTMATH_SSE2
+        for (; i + 2 <= n; i += 2)
+            _mm_storeu_pd(out + i, _mm_div_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+#endif
+        for (; i < n; i++)
+            out[i] = a[i] / b[i];
+    }
+
+private:
+#if FASTMATH_SSE2
+    // two samples, with the operators the approximations below are written with
+    struct Pair
+    {
+        Pair(__m128d _v) : v(_v) {}
+        Pair(double d) : v(_mm_set1_pd(d)) {}
+        friend Pair operator+(Pair a, Pair b) { return _mm_add_pd(a.v, b.v); }
+        friend Pair operator-(Pair a, Pair b) { return _mm_sub_pd(a.v, b.v); }
+        friend Pair operator*(Pair a, Pair b) { return _mm_mul_pd(a.v, b.v); }
+        friend Pair operator/(Pair a, Pair b) { return _mm_div_pd(a.v, b.v); }
+        // comparisons give a mask of all ones or zeros for select
+        friend Pair operator<(Pair a, Pair b) { return _mm_cmplt_pd(a.v, b.v); }
+        friend Pair operator>(Pair a, Pair b) { return _mm_cmpgt_pd(a.v, b.v); }
+        __m128d v;
+    };
+    static Pair select(Pair mask, Pair a, Pair b)
+    {
+        return _mm_or_pd(_mm_and_pd(mask.v, a.v), _mm_andnot_pd(mask.v, b.v));
+    }
+    // std::trunc without SSE4.1: adding and removing 2^52 rounds the magnitude to a whole
+    // number, a result above it is one too large. Larger magnitudes are whole already
+    static Pair trunc(Pair x)
+    {
+        const Pair sign = -0.0, big = 4503599627370496.0;
+        Pair magnitude = _mm_andnot_pd(sign.v, x.v);
+        Pair rounded = (magnitude + big) - big;
+        rounded = rounded - select(rounded > magnitude, 1.0, 0.0);
+        rounded = select(magnitude < big, rounded, magnitude);
+        return _mm_or_pd(rounded.v, _mm_and_pd(sign.v, x.v));
+    }
+#endif
+    static double select(bool condition, double a, double b)
+    {
+        return condition ? a : b;
+    }
+    static double trunc(double x)
+    {
+        return std::trunc(x);
+    }
+    // out[i] = f(x[i]), two samples at a time where SSE2 is available
+    template <typename Kernel>
+    static void map(const double *x, double *out, int n, Kernel f)
+    {
+        int i = 0;
+#if FASTMATH_SSE2
+        for (; i + 2 <= n; i += 2)
+            _mm_storeu_pd(out + i, f(Pair(_mm_loadu_pd(x + i))).v);
+#endif
+        for (; i < n; i++)
+            out[i] = f(x[i]);
+    }
+
+    // the approximations, for one sample or a Pair
+    template <typename T>
+    static T wrap(T x, double period)
+    {
+        return x - period * trunc(x / period);
+    }
+    template <typename T>
+    static T floor(T x)
+    {
+        T whole = trunc(x);
+        return whole - select(whole > x, 1.0, 0.0);
+    }
+    template <typename T>
+    static T sin(T x)
+    {
+        const double pi = juce::MathConstants<double>::pi;
+        x = x - juce::MathConstants<double>::twoPi * floor(x * (0.5 / pi) + 0.5);
+        x = select(x > pi / 2, pi - x, select(x < -pi / 2, -pi - x, x));
+        T x2 = x * x;
+        return x * (1.0 + x2 * (-1.0 / 6 + x2 * (1.0 / 120 + x2 * (-1.0 / 5040 + x2 * (1.0 / 362880 + x2 * (-1.0 / 39916800))))));
+    }
+    template <typename T>
+    static T square(T x)
+    {
+        const double pi = juce::MathConstants<double>::pi;
+        return select(wrap(x, 2.0 * pi) > pi, -1.0, 1.0);
+    }
+    template <typename T>
+    static T sawtooth(T x)
+    {
+        const double pi = juce::MathConstants<double>::pi;
+        T w = wrap(x, 2.0 * pi);
+        return w / pi - select(w > pi, 2.0, 0.0);
+    }
+    template <typename T>
+    static T triangle(T x)
+    {
+        const double pi = juce::MathConstants<double>::pi;
+        T w = wrap(x + pi / 2.0, 2.0 * pi) - pi;
+        return select(w < 0.0, 1.0 + 2.0 * w / pi, 1.0 - 2.0 * w / pi);
+    }
+};
+
+class F;
+
+// Flat register program compiled from a tree of F. Every instruction runs over a whole
+// block. Subtrees that don't depend on x are folded into constants when the program is
+// compiled, run only checks the parameters they read and folds them again after an edit.
+// Functions without an instruction of their own are called through processBlock.
+class FunctionProgram
+{
+public:
+    enum class Op
+    {
+        Param,
+        Sin,
+        Square,
+        Sawtooth,
+        Triangle,
+        Line,
+        Add,
+        Substract,
+        Multiply,
+        Divide,
+        Wrap,
+        Select,
+        Random,
+        Call
+    };
+    static constexpr int max_block = 64;
+    // the register holding x
+    static const int input = 0;
+    // replaces the program, not to be called while run is running
+    void compile(F *root);
+    bool empty() const
+    {
+        return code.empty() && folded.empty();
+    }
+    // the instructions run for every block, folded ones aren't counted
+    int size() const
+    {
+        return (int)code.size();
+    }
+    // n is at most max_block
+    void run(const double *x, double *out, int n);
+
+    // used by F::compile, each returns the register of the result
+    int param(const float *value)
+    {
+        return emit({Op::Param, 0, 0, 0, value, nullptr, nullptr, 0}, true);
+    }
+    int unary(Op op, int a)
+    {
+        return emit({op, 0, a, 0, nullptr, nullptr, nullptr, 0}, uniform[a]);
+    }
+    int binary(Op op, int a, int b)
+    {
+        return emit({op, 0, a, b, nullptr, nullptr, nullptr, 0}, uniform[a] && uniform[b]);
+    }
+    int line(int a, const float *start, const float *end)
+    {
+        return emit({Op::Line, 0, a, 0, start, end, nullptr, 0}, uniform[a]);
+    }
+    int wrap(int a, double period)
+    {
+        return emit({Op::Wrap, 0, a, 0, nullptr, nullptr, nullptr, period}, uniform[a]);
+    }
+    // result = x of a < constant ? b : c
+    int select(int a, double constant, int b, int c)
+    {
+        int r = emit({Op::Select, 0, a, b, nullptr, nullptr, nullptr, constant}, uniform[a] && uniform[b] && uniform[c]);
+        code.back().c = c;
+        return r;
+    }
+    // uniform noise in [-1, 1). The generator belongs to the program, so sources that
+    // render in parallel don't share one
+    int random(juce::int64 seed)
+    {
+        int r = emit({Op::Random, 0, 0, 0, nullptr, nullptr, nullptr, 0}, false);
+        code.back().c = (int)randoms.size();
+        randoms.emplace_back(seed);
+        return r;
+    }
+    // a function that can't be compiled, it may hold state so it is never treated as uniform
+    int call(F *f, int a)
+    {
+        return emit({Op::Call, 0, a, 0, nullptr, nullptr, f, 0}, false);
+    }
+
+private:
+    struct Instruction
+    {
+        Op op;
+        int dst;
+        int a, b;
+        const float *p1, *p2;
+        F *f;
+        double constant;
+        int c = 0;
+        bool uniform = false;
+    };
+    int emit(Instruction instruction, bool is_uniform)
+    {
+        instruction.dst = (int)uniform.size();
+        instruction.uniform = is_uniform;
+        uniform.push_back(is_uniform);
+        code.push_back(instruction);
+        return instruction.dst;
+    }
+    // a parameter read by a folded instruction and the value it was folded with
+    struct Folded
+    {
+        const float *value;
+        float seen;
+    };
+    double *reg(int r)
+    {
+        return registers.data() + (size_t)r * max_block;
+    }
+    void execute(const Instruction &i, int n);
+    // evaluates the folded instructions and fills their registers for any block size
+    void fold();
+    std::vector<Instruction> code;
+    std::vector<Instruction> folded;
+    std::vector<Folded> parameters;
+    std::vector<bool> uniform;
+    std::vector<double> registers;
+    std::vector<juce::Random> randoms;
+    int result = input;
+};
 
 class F
 {
 public:
+    // largest block passed to processBlock, the temporaries of a block live on the stack
+    static constexpr int max_block = FunctionProgram::max_block;
     F(std::vector<F **> _f)
     {
         fs = _f;
         size = fs.size();
     }
+    virtual ~F() = default;
     virtual double get(double x) = 0;
+    // emits the instructions computing this function of register x, returns the result register
+    virtual int compile(FunctionProgram &program, int x)
+    {
+        return program.call(this, x);
+    }
+    // out[i] = get(x[i]) for a whole block with one virtual call per function, out may be x
+    void process(const double *x, double *out, int n)
+    {
+        for (int i = 0; i < n; i += max_block)
+            processBlock(x + i, out + i, std::min(max_block, n - i));
+    }
 
 protected:
+    friend class FunctionProgram;
+    virtual void processBlock(const double *x, double *out, int n)
+    {
+        for (int i = 0; i < n; i++)
+            out[i] = get(x[i]);
+    }
     double use_f(int index, double x)
     {
         if (index >= size)
@@ -22,6 +383,22 @@ protected:
             return x;
         return (*(fs[index]))->get(x);
     }
+    void use_f(int index, const double *x, double *out, int n)
+    {
+        if (index >= size || fs[index] == nullptr || *(fs[index]) == nullptr)
+        {
+            if (out != x)
+                std::copy(x, x + n, out);
+            return;
+        }
+        (*(fs[index]))->processBlock(x, out, n);
+    }
+    int compile_f(FunctionProgram &program, int index, int x)
+    {
+        if (index >= size || fs[index] == nullptr || *(fs[index]) == nullptr)
+            return x;
+        return (*(fs[index]))->compile(program, x);
+    }
 
 private:
     std::vector<F **> fs;
@@ -38,6 +415,14 @@ public:
     {
         return a;
     }
+    void processBlock(const double *x, double *out, int n) override
+    {
+        std::fill(out, out + n, (double)a);
+    }
+    int compile(FunctionProgram &program, int x) override
+    {
+        return program.param(&a);
+    }
 
 private:
     float &a;
@@ -45,14 +430,19 @@ private:
 class Random : public F
 {
 public:
+    static constexpr juce::int64 seed = 123;
     Random() : F(std::vector<F **>({}))
     {
-        random.setSeed(123);
+        random.setSeed(seed);
     };
     double get(double x)
     {
         return random.nextDouble() * 2 - 1;
     }
+    int compile(FunctionProgram &program, int x) override
+    {
+        return program.random(seed);
+    }
 
 private:
     juce::Random random;
@@ -66,6 +456,15 @@ public:
     {
         return (double)std::sin(use_f(0, x));
     }
+    void processBlock(const double *x, double *out, int n) override
+    {
+        use_f(0, x, out, n);
+        FastMath::sin(out, out, n);
+    }
+    int compile(FunctionProgram &program, int x) override
+    {
+        return program.unary(FunctionProgram::Op::Sin, compile_f(program, 0, x));
+    }
 };
 class Square : public F
 {
@@ -73,16 +472,16 @@ public:
     Square(std::vector<F **> _f) : F(_f) {}
     double get(double rad) override
     {
-        double x = use_f(0, rad);
-        x = std::fmod(x, 2.0f * juce::MathConstants<double>::pi);
-        if (x > juce::MathConstants<double>::pi)
-        {
-            return -1;
-        }
-        else
-        {
-            return 1;
-        }
+        return ExactMath::square(use_f(0, rad));
+    }
+    void processBlock(const double *x, double *out, int n) override
+    {
+        use_f(0, x, out, n);
+        FastMath::square(out, out, n);
+    }
+    int compile(FunctionProgram &program, int x) override
+    {
+        return program.unary(FunctionProgram::Op::Square, compile_f(program, 0, x));
     }
 };
 class Sawtooth : public F
@@ -91,12 +490,16 @@ public:
     Sawtooth(std::vector<F **> _f) : F(_f) {}
     double get(double rad) override
     {
-        rad = use_f(0, rad);
-        double x = std::fmod(rad, 2.0f * juce::MathConstants<double>::pi);
-        if (x > juce::MathConstants<double>::pi)
-            return juce::jmap(x, juce::MathConstants<double>::pi, 2.0f * juce::MathConstants<double>::pi, -1.0, 0.0);
-        else
-            return juce::jmap(x, 0.0, juce::MathConstants<double>::pi, 0.0, 1.0);
+        return ExactMath::sawtooth(use_f(0, rad));
+    }
+    void processBlock(const double *x, double *out, int n) override
+    {
+        use_f(0, x, out, n);
+        FastMath::sawtooth(out, out, n);
+    }
+    int compile(FunctionProgram &program, int x) override
+    {
+        return program.unary(FunctionProgram::Op::Sawtooth, compile_f(program, 0, x));
     }
 };
 class Triangle : public F
@@ -105,21 +508,16 @@ public:
     Triangle(std::vector<F **> _f) : F(_f) {}
     double get(double rad) override
     {
-        rad = use_f(0, rad);
-        rad = rad + juce::MathConstants<double>::pi / 2.0;
-
-        double x = std::fmod(rad, 2.0f * juce::MathConstants<double>::pi) - juce::MathConstants<double>::pi;
-        double res = (x < 0) ? juce::jmap(x,
-                                          double(-juce::MathConstants<double>::pi),
-                                          double(0),
-                                          double(-1),
-                                          double(1))
-                             : juce::jmap(x,
-                                          double(0),
-                                          double(juce::MathConstants<double>::pi),
-                                          double(1),
-                                          double(-1));
-        return res;
+        return ExactMath::triangle(use_f(0, rad));
+    }
+    void processBlock(const double *x, double *out, int n) override
+    {
+        use_f(0, x, out, n);
+        FastMath::triangle(out, out, n);
+    }
+    int compile(FunctionProgram &program, int x) override
+    {
+        return program.unary(FunctionProgram::Op::Triangle, compile_f(program, 0, x));
     }
 };
 
@@ -132,9 +530,16 @@ public:
 
     double get(double rad)
     {
-        rad = use_f(0, rad);
-        double x = std::fmod(rad, juce::MathConstants<double>::twoPi);
-        return juce::jmap(x, 0.0, juce::MathConstants<double>::twoPi, (double)start, (double)end);
+        return ExactMath::line(use_f(0, rad), start, end);
+    }
+    void processBlock(const double *x, double *out, int n) override
+    {
+        use_f(0, x, out, n);
+        FastMath::line(out, out, n, start, end);
+    }
+    int compile(FunctionProgram &program, int x) override
+    {
+        return program.line(compile_f(program, 0, x), &start, &end);
     }
 
 private:
@@ -150,6 +555,17 @@ public:
     {
         return use_f(0, x) + use_f(1, x);
     }
+    void processBlock(const double *x, double *out, int n) override
+    {
+        double b[max_block];
+        use_f(1, x, b, n);
+        use_f(0, x, out, n);
+        juce::FloatVectorOperations::add(out, b, n);
+    }
+    int compile(FunctionProgram &program, int x) override
+    {
+        return program.binary(FunctionProgram::Op::Add, compile_f(program, 0, x), compile_f(program, 1, x));
+    }
 };
 class Substract : public F
 {
@@ -159,6 +575,17 @@ public:
     {
         return use_f(0, x) - use_f(1, x);
     }
+    void processBlock(const double *x, double *out, int n) override
+    {
+        double b[max_block];
+        use_f(1, x, b, n);
+        use_f(0, x, out, n);
+        juce::FloatVectorOperations::subtract(out, b, n);
+    }
+    int compile(FunctionProgram &program, int x) override
+    {
+        return program.binary(FunctionProgram::Op::Substract, compile_f(program, 0, x), compile_f(program, 1, x));
+    }
 };
 class Multiply : public F
 {
@@ -169,6 +596,17 @@ public:
     {
         return use_f(0, x) * use_f(1, x);
     }
+    void processBlock(const double *x, double *out, int n) override
+    {
+        double b[max_block];
+        use_f(1, x, b, n);
+        use_f(0, x, out, n);
+        juce::FloatVectorOperations::multiply(out, b, n);
+    }
+    int compile(FunctionProgram &program, int x) override
+    {
+        return program.binary(FunctionProgram::Op::Multiply, compile_f(program, 0, x), compile_f(program, 1, x));
+    }
 };
 class Divide : public F
 {
@@ -179,6 +617,17 @@ public:
     {
         return use_f(0, x) / use_f(1, x);
     }
+    void processBlock(const double *x, double *out, int n) override
+    {
+        double b[max_block];
+        use_f(1, x, b, n);
+        use_f(0, x, out, n);
+        FastMath::divide(out, b, out, n);
+    }
+    int compile(FunctionProgram &program, int x) override
+    {
+        return program.binary(FunctionProgram::Op::Divide, compile_f(program, 0, x), compile_f(program, 1, x));
+    }
 };
 
 class Concatenate : public F
@@ -198,6 +647,135 @@ public:
             return use_f(1, x);
         }
     }
+    void processBlock(const double *x, double *out, int n) override
+    {
+        double wrapped[max_block], first[max_block];
+        FastMath::wrap(x, wrapped, n, 4.0f * juce::MathConstants<double>::pi);
+        use_f(0, wrapped, first, n);
+        use_f(1, wrapped, out, n);
+        for (int i = 0; i < n; i++)
+            out[i] = wrapped[i] < juce::MathConstants<double>::twoPi ? first[i] : out[i];
+    }
+    int compile(FunctionProgram &program, int x) override
+    {
+        int wrapped = program.wrap(x, 4.0f * juce::MathConstants<double>::pi);
+        int first = compile_f(program, 0, wrapped);
+        int second = compile_f(program, 1, wrapped);
+        return program.select(wrapped, juce::MathConstants<double>::twoPi, first, second);
+    }
 
 private:
-};
\ No newline at end of file
+};
+
+inline void FunctionProgram::compile(F *root)
+{
+    code.clear();
+    folded.clear();
+    parameters.clear();
+    randoms.clear();
+    uniform.assign(1, false);
+    result = root != nullptr ? root->compile(*this, input) : input;
+    registers.assign(uniform.size() * (size_t)max_block, 0.0);
+    // a uniform instruction only reads uniform registers, so the folded ones keep their order
+    std::vector<Instruction> varying;
+    for (auto &i : code)
+    {
+        if (!i.uniform)
+        {
+            varying.push_back(i);
+            continue;
+        }
+        folded.push_back(i);
+        for (auto value : {i.p1, i.p2})
+        {
+            if (value != nullptr)
+                parameters.push_back({value, *value});
+        }
+    }
+    code = std::move(varying);
+    fold();
+}
+
+inline void FunctionProgram::fold()
+{
+    for (auto &p : parameters)
+        p.seen = *p.value;
+    for (auto &i : folded)
+    {
+        execute(i, 1);
+        std::fill(reg(i.dst) + 1, reg(i.dst) + max_block, reg(i.dst)[0]);
+    }
+}
+
+inline void FunctionProgram::run(const double *x, double *out, int n)
+{
+    for (auto &p : parameters)
+    {
+        if (*p.value != p.seen)
+        {
+            fold();
+            break;
+        }
+    }
+    std::copy(x, x + n, reg(input));
+    for (auto &i : code)
+        execute(i, n);
+    std::copy(reg(result), reg(result) + n, out);
+}
+
+inline void FunctionProgram::execute(const Instruction &i, int n)
+{
+    double *d = reg(i.dst);
+    const double *a = reg(i.a);
+    const double *b = reg(i.b);
+    switch (i.op)
+    {
+    case Op::Param:
+        d[0] = *i.p1;
+        break;
+    case Op::Sin:
+        FastMath::sin(a, d, n);
+        break;
+    case Op::Square:
+        FastMath::square(a, d, n);
+        break;
+    case Op::Sawtooth:
+        FastMath::sawtooth(a, d, n);
+        break;
+    case Op::Triangle:
+        FastMath::triangle(a, d, n);
+        break;
+    case Op::Line:
+        FastMath::line(a, d, n, *i.p1, *i.p2);
+        break;
+    case Op::Add:
+        juce::FloatVectorOperations::add(d, a, b, n);
+        break;
+    case Op::Substract:
+        juce::FloatVectorOperations::subtract(d, a, b, n);
+        break;
+    case Op::Multiply:
+        juce::FloatVectorOperations::multiply(d, a, b, n);
+        break;
+    case Op::Divide:
+        FastMath::divide(a, b, d, n);
+        break;
+    case Op::Wrap:
+        FastMath::wrap(a, d, n, i.constant);
+        break;
+    case Op::Select:
+    {
+        const double *c = reg(i.c);
+        for (int k = 0; k < n; k++)
+            d[k] = a[k] < i.constant ? b[k] : c[k];
+        break;
+    }
+    case Op::Random:
+        for (int k = 0; k < n; k++)
+            d[k] = randoms[(size_t)i.c].nextDouble() * 2 - 1;
+        break;
+    case Op::Call:
+        i.f->processBlock(a, d, n);
+        break;
+    }
+}
@@ -5,7 +5,9 @@
 #include "NodeEditorComponent.h"
 #include "NodeDropdown.h"
 #include "NodeGraph.h"
+#include "GraphCompiler.h"
 #include "NodeTypesFactory.h"
+#include "ProjectLoader.h"
 #include <fstream>
 
 const int SAMPLE_RATE = 48000;
@@ -157,7 +159,7 @@ private:
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(StretchComponent)
 };
 
-class MainComponent : public juce::Component
+class MainComponent : public juce::Component, public GraphListener, private juce::AsyncUpdater
 {
 public:
     MainComponent() : g(new RecoverableNodeGraph()), node_editor(g.get()),
@@ -171,6 +173,15 @@ public:
         addAndMakeVisible(stretcher);
 
         factory.reset(new NoundTypesFactory());
+        loader.reset(new ProjectLoader(g.get(), factory.get(), SAMPLE_RATE));
+        loader->onProgress = [this]
+        { loadingChanged(); };
+        loader->onClear = [this]
+        { stop(); };
+        g->registerListener(this);
+        // deleted nodes may still be read by the playing sources
+        g->setNodeDeleter([](Node *node)
+                          { Reclaimer::getInstance().retire(node); });
 
         file_button.setButtonText("File");
         file_button.onClick = [&]
@@ -184,10 +195,19 @@ public:
                          { save_as(); });
             menu.addItem("Export", [this]
                          { export_graph(); });
+            // long compressed files are copied uncompressed for instant seeks, off by default
+            menu.addItem("Keep Uncompressed Copies", true, SidecarCache::getInstance().isEnabled(), []
+                         { SidecarCache::getInstance().setEnabled(!SidecarCache::getInstance().isEnabled()); });
             menu.showMenuAsync(juce::PopupMenu::Options{}.withTargetComponent(file_button));
         };
+        cancel_button.setButtonText("Cancel");
+        cancel_button.onClick = [this]
+        { loader->cancel(); };
+        loading_bar.setSize(200, 20);
         toolbar.setColor(App::ThemeProvider::getCurrentTheme()->darkerColor);
-        toolbar.addElements(std::vector<juce::Component *>({&file_button}));
+        toolbar.addElements(std::vector<juce::Component *>({&file_button, &loading_bar, &cancel_button}));
+        loading_bar.setVisible(false);
+        cancel_button.setVisible(false);
         addAndMakeVisible(toolbar);
 
         juce::Image play_img = getImageFromAssets("play_white.png");
@@ -259,60 +279,163 @@ public:
     }
     ~MainComponent() override
     {
+        loader.reset();
+        cancelPendingUpdate();
+        // what the audio thread may still have read is deleted now, while everything the
+        // sources use is still there
+        stop();
+        Reclaimer::getInstance().retire(scheduled);
+        Reclaimer::getInstance().collect(true);
     }
 
     void paint(juce::Graphics &g)
     {
     }
-    void build()
+    bool build()
+    {
+        if (!compile())
+            return false;
+        plan.execute();
+        return true;
+    }
+    bool compile()
     {
-        auto graph = g.get();
-        Value d = nullptr;
-        for (auto &[id, n] : graph->getNodes())
+        // the plan is compiled again only after structural changes
+        if (plan_version != g->getVersion())
         {
-            if (graph->getInputConnectionsOfNode(id).size() == 0)
+            try
+            {
+                plan = compiler.compile(g.get());
+            }
+            catch (const std::invalid_argument &e)
             {
-                n->trigger(d, nullptr);
+                std::cerr << "Error: " << e.what() << std::endl;
+                return false;
             }
+            plan_version = g->getVersion();
+        }
+        return true;
+    }
+    PositionableSource *getOutputSource()
+    {
+        for (auto &[id, n] : g->getNodesOfType((int)NodeTypes::Output))
+        {
+            return ((OutputNode *)n)->result;
         };
+        return nullptr;
+    }
+    // the output source with the tees it reads, built again for every plan because any tee
+    // may have been replaced. nullptr without an output
+    PositionableSource *schedule()
+    {
+        Reclaimer::getInstance().retire(scheduled);
+        scheduled = nullptr;
+        auto output = getOutputSource();
+        if (output == nullptr)
+            return nullptr;
+        std::vector<TeeSource *> tees;
+        for (auto n : plan.order)
+        {
+            auto node = dynamic_cast<FanOutNode *>(n);
+            if (node != nullptr && node->getTee() != nullptr)
+                tees.push_back(node->getTee());
+        }
+        scheduled = new ScheduledSource(output, std::move(tees));
+        return scheduled;
+    }
+    // the most pooled buffers the sources take at once, any of them can render at the same
+    // time as the others
+    int countScratchBuffers()
+    {
+        int count = 0;
+        g->forEachNode([&](Node *node)
+                       { count += ((EditorNode *)node)->getScratchBuffers(); });
+        return count;
+    }
+    // builds new sources for the changed nodes and everything downstream of them and hands
+    // them to the player, the other nodes keep the sources that are playing. The replaced
+    // sources are deleted once the audio thread released them
+    void rebuildLive()
+    {
+        if (!compile())
+        {
+            Reclaimer::getInstance().retire(scheduled);
+            scheduled = nullptr;
+            player.publish(nullptr, 0);
+            return;
+        }
+        plan.propagate();
+        for (auto n : plan.order)
+        {
+            if (n->dirty)
+                ((EditorNode *)n)->retireSources();
+        }
+        plan.execute();
+        player.publish(schedule(), countScratchBuffers());
     }
     void play()
     {
         stop();
-        build();
-        auto graph = g.get();
-        graph->disableDeletion();
-        for (auto &[id, n] : graph->getNodes())
-        {
-            if (auto out = dynamic_cast<OutputNode *>(n))
-            {
-                if (out->result == nullptr)
-                    return;
-                player.setSource(out->result);
-                player.setPosition(position_slider.getValue());
-                player.Start();
-                playing = true;
-                break;
-            }
-        };
+        if (!build())
+            return;
+        auto output = schedule();
+        if (output == nullptr)
+            return;
+        player.setSource(output, countScratchBuffers());
+        player.setPosition(position_slider.getValue());
+        player.Start();
+        playing = true;
     }
     void stop()
     {
         playing = false;
         player.Stop();
-        g->enableDeletion();
     }
     void pause()
     {
         playing = false;
         player.Stop();
-        g->enableDeletion();
     }
     void resume()
     {
+        // the nodes edited while paused are rebuilt
+        rebuildLive();
         playing = true;
         player.resume();
-        g->disableDeletion();
+    }
+
+    void NodeAdded([[maybe_unused]] Node *node) override
+    {
+    }
+    void NodeDeleted([[maybe_unused]] int id) override
+    {
+        graphChanged();
+    }
+    void ConnectionAdded([[maybe_unused]] Connection *connection) override
+    {
+        graphChanged();
+    }
+    void ConnectionDeleted([[maybe_unused]] int id) override
+    {
+        graphChanged();
+    }
+    void NodeChanged([[maybe_unused]] Node *node) override
+    {
+        graphChanged();
+    }
+    void GraphChanged([[maybe_unused]] const GraphChangeSet &changes) override
+    {
+        graphChanged();
+    }
+    void graphChanged()
+    {
+        if (playing)
+            triggerAsyncUpdate();
+    }
+    void handleAsyncUpdate() override
+    {
+        if (playing)
+            rebuildLive();
     }
 
     void save_as()
@@ -345,9 +468,9 @@ public:
     void new_graph()
     {
         stop();
+        loader->cancel();
         GraphInfo info;
         g.get()->recover(info, factory.get());
-        node_editor.update();
     }
     void open()
     {
@@ -401,6 +524,7 @@ public:
         // play_button.changeWidthToFitText();
         // stop_button.changeWidthToFitText();
         file_button.changeWidthToFitText();
+        cancel_button.changeWidthToFitText();
         fb.items.add(juce::FlexItem(getWidth(), 25, toolbar));
         fb.items.add(juce::FlexItem(getWidth(), 50, play_panel).withMargin(0));
         fb.items.add(juce::FlexItem(getWidth(), 50, stretcher).withFlex(1));
@@ -410,27 +534,21 @@ public:
     void setGraphInfo(juce::String path)
     {
         stop();
-        std::ifstream file(path.getCharPointer());
-        if (file.is_open())
-        {
-            GraphInfo info;
-            file >> info;
-            file.close();
-            g.get()->recover(info, factory.get());
-            node_editor.update();
-        }
-        else
-        {
-            std::cerr << "Error: Unable to open file." << std::endl;
-        }
+        loader->load(path);
+    }
+    void loadingChanged()
+    {
+        bool loading = loader->isLoading();
+        loading_progress = loader->getProgress();
+        loading_bar.setTextToDisplay(loader->getStatus());
+        loading_bar.setVisible(loading);
+        cancel_button.setVisible(loading);
     }
     void saveGraphInfo(juce::String path)
     {
         std::unordered_map<int, juce::Point<int>> positions;
-        for (auto &[id, node] : g.get()->getNodes())
-        {
-            positions[id] = node_editor.getNodePosition(id);
-        }
+        g.get()->forEachNode([&](Node *node)
+                             { positions[node->id] = node_editor.getNodePosition(node->id); });
         auto info = g.get()->get_info(positions);
         std::ofstream file(path.getCharPointer(), std::ofstream::out | std::ofstream::trunc);
 
@@ -459,18 +577,11 @@ public:
         juce::File file = juce::File(path);
         if (file.existsAsFile())
             file.deleteFile();
-        juce::AudioBuffer<float> buffer;
         juce::WavAudioFormat format;
         std::unique_ptr<juce::AudioFormatWriter> writer;
-        build();
-        PositionableSource *output = nullptr;
-        for (auto &[id, n] : g.get()->getNodes())
-        {
-            if (auto out = dynamic_cast<OutputNode *>(n))
-            {
-                output = (out->result);
-            }
-        };
+        if (!build())
+            return;
+        PositionableSource *output = schedule();
         if (output == nullptr)
             return;
         const int size = 480;
@@ -480,12 +591,14 @@ public:
                                             24,
                                             {},
                                             0));
-        output->prepareToPlay(480, SAMPLE_RATE);
+        PositionableSource::restart();
+        output->prepareToPlay(size, SAMPLE_RATE);
+        Reclaimer::getInstance().retire(ScratchPool::getInstance().reserve(countScratchBuffers(), size));
         output->setPosition();
+        juce::AudioBuffer<float> buffer(2, size);
         while (output->isPlaying())
         {
-            juce::AudioBuffer<float> buffer;
-            buffer.setSize(2, 480);
+            buffer.clear();
             output->getNextAudioBlock(juce::AudioSourceChannelInfo(&buffer, 0, size));
 
             if (writer != nullptr)
@@ -498,6 +611,12 @@ private:
     Player player;
     std::unique_ptr<RecoverableNodeGraph> g;
     std::unique_ptr<TypesRecoverFactory> factory;
+    std::unique_ptr<ProjectLoader> loader;
+    GraphCompiler compiler;
+    ExecutionPlan plan;
+    // what the player plays, retired when it is replaced
+    ScheduledSource *scheduled = nullptr;
+    int plan_version = -1;
     NodeEditorComponent node_editor;
     DropdownComponent dropdown_panel;
     StretchComponent stretcher;
@@ -505,6 +624,9 @@ private:
     juce::ImageButton pause_button;
     juce::ImageButton stop_button;
     MenuButton file_button;
+    double loading_progress = 0;
+    juce::ProgressBar loading_bar{loading_progress};
+    juce::TextButton cancel_button;
     FlexWithColor toolbar;
     FlexWithColor play_panel;
     juce::Slider position_slider;
@@ -512,7 +634,7 @@ private:
     Vertical v;
     std::unique_ptr<juce::FileChooser> fc = nullptr;
     juce::String selected_file_path;
-    bool playing;
+    bool playing = false;
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MainComponent)
 };
 
@@ -76,6 +76,7 @@ public:
                                               new ItemWithNode(NodeNames::FileReader, std::vector<Item *>(), new NodeCreateCommand<FileReaderNode>, g),
                                               new ItemWithNode(NodeNames::Oscillator, std::vector<Item *>(), new NodeCreateCommand<OscillatorNode>, g),
                                               new ItemWithNode(NodeNames::AudioMathNode, std::vector<Item *>(), new NodeCreateCommand<AudioMathNode>, g),
+                                              new ItemWithNode(NodeNames::MixerNode, std::vector<Item *>(), new NodeCreateCommand<MixerNode>, g),
                                               new ItemWithNode(NodeNames::Concatenate, std::vector<Item *>(), new NodeCreateCommand<ConcatenateNode>, g),
                                               new ItemWithNode(NodeNames::RepeatNode, std::vector<Item *>(), new NodeCreateCommand<RepeatNode>, g),
                                               new ItemWithNode(NodeNames::TrimNode, std::vector<Item *>(), new NodeCreateCommand<TrimNode>, g),
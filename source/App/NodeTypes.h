@@ -9,6 +9,17 @@
 
 #include "NodeTypesRegistry.h"
 
+template <>
+struct PinTraits<F *>
+{
+    static const int type = PinType::Function;
+};
+template <>
+struct PinTraits<PositionableSource *>
+{
+    static const int type = PinType::Audio;
+};
+
 class AbstractNodeCreateCommand
 {
 public:
@@ -27,20 +38,74 @@ public:
 
 // audio
 
-class AudioNode : public EditorNode
+// hands one source to every connection of an output, through a tee when there are several
+class FanOut
+{
+public:
+    ~FanOut()
+    {
+        delete tee;
+    }
+    void pass(const ConnectionList &connections, PositionableSource *source)
+    {
+        if (connections.size() <= 1 || source == nullptr)
+        {
+            for (auto &c : connections)
+                c->value = source;
+            return;
+        }
+        // the playing tree may still read the last tee, every build gets its own
+        retire();
+        tee = new TeeSource();
+        tee->setSource(source);
+        tee->setReaders(connections.size());
+        for (int i = 0; i < connections.size(); i++)
+            connections[i]->value = tee->getReader(i);
+    }
+    void retire()
+    {
+        Reclaimer::getInstance().retire(tee);
+        tee = nullptr;
+    }
+    // nullptr unless several connections read the source
+    TeeSource *getTee()
+    {
+        return tee;
+    }
+
+private:
+    TeeSource *tee = nullptr;
+};
+
+// a node that hands its source out through a FanOut, its tee is rendered before the
+// consumers of every block
+class FanOutNode
+{
+public:
+    virtual ~FanOutNode() = default;
+    virtual TeeSource *getTee() = 0;
+};
+
+class AudioNode : public EditorNode, public FanOutNode
 {
 public:
     AudioNode(int _output_id) : EditorNode(), output_id(_output_id){
 
                                               };
     ~AudioNode()
+    {
+        clearSources();
+    }
+    void retireSources() override
     {
         for (auto &s : sources)
-        {
-            delete s;
-            s = nullptr;
-        }
+            Reclaimer::getInstance().retire(s);
         sources.clear();
+        fan_out.retire();
+    }
+    TeeSource *getTee() override
+    {
+        return fan_out.getTee();
     }
 
 protected:
@@ -53,20 +118,33 @@ protected:
         }
         sources.clear();
     }
-    void passSources(std::function<PositionableSource *()> func)
+    template <class Create>
+    void passSources(Create create)
     {
-        auto connection_inputs = graph->getInputsOfOutput(outputs[output_id]);
-        for (int i = 0; i < connection_inputs.size(); i++)
+        passSources(create, [](PositionableSource *) {});
+    }
+    // reuses the source of the previous build or creates it and configures it for the
+    // current inputs, a single source is rendered however many connections read it
+    template <class Create, class Configure>
+    void passSources(Create create, Configure configure)
+    {
+        auto &connections = outputs[output_id]->connections;
+        if (connections.empty())
         {
-            auto input = connection_inputs[i];
-            if (i == sources.size())
-            {
-                sources.push_back(func());
-            }
-            input->node->trigger((Value)((PositionableSource *)sources[i]), input);
+            retireSources();
+            return;
         }
+        if (sources.empty())
+            sources.push_back(create());
+        configure(sources[0]);
+        fan_out.pass(connections, sources[0]);
+    }
+    void passNothing()
+    {
+        setOutputValue(output_id, (PositionableSource *)nullptr);
     }
     std::vector<PositionableSource *> sources;
+    FanOut fan_out;
     int output_id;
 };
 
@@ -82,25 +160,20 @@ public:
         result = nullptr;
         header = NodeNames::OutputNode;
         type_id = (int)NodeTypes::Output;
-        inputs[InputKeys::audio_] = new Input(InputKeys::audio_, "audio", PinType::Audio, this);
+        registerInput(InputKeys::audio_, "audio", PinType::Audio);
     };
     // SoundOutputSource source;
     PositionableSource *result;
 
 private:
-    void trigger(Value &data, [[maybe_unused]] Input *pin) override
+    void process() override
     {
         result = nullptr;
-        if (pin == inputs[InputKeys::audio_])
-        {
-            result = std::any_cast<PositionableSource *>(data);
-            //  source.setSource(f);
-            //  source.Start();
-        }
+        getInput(InputKeys::audio_, result);
     }
 };
 
-class FileReaderNode : public EditorNode, public FileInput::Listener
+class FileReaderNode : public EditorNode, public FileInput::Listener, public FanOutNode
 {
 public:
     enum InputKeys
@@ -117,7 +190,7 @@ public:
         registerInternal(new FileInput(new StringRef(name), this));
         header = NodeNames::FileReader;
         type_id = (int)NodeTypes::FileReader;
-        outputs[OutputKeys::audio_] = new Output(OutputKeys::audio_, "audio", PinType::Audio, this);
+        registerOutput(OutputKeys::audio_, "audio", PinType::Audio);
         registerOutput(OutputKeys::length_out, "seconds", PinType::Number);
         t = 0;
     };
@@ -128,49 +201,51 @@ public:
 
     void fileChanged() override
     {
-        for (auto &s : sources)
-        {
-            s->setFile(name);
-        }
-        if (sources.size() > 0)
-            t = sources[0]->getLengthInSeconds();
+        // the file is opened on the next build
     };
+    // the open file is kept, it is never changed while it plays, only replaced
+    void retireSources() override
+    {
+        fan_out.retire();
+    }
+    TeeSource *getTee() override
+    {
+        return fan_out.getTee();
+    }
 
 private:
     float t;
     std::string name;
     juce::URL *currentAudioFile;
-    std::vector<std::unique_ptr<FileSource>> sources;
+    std::unique_ptr<FileSource> source;
+    FanOut fan_out;
 
-    void trigger(Value &data, [[maybe_unused]] Input *pin) override
+    void process() override
     {
-        if (name == "")
-            return;
-        auto connection_inputs = graph->getInputsOfOutput(outputs[OutputKeys::audio_]);
-        for (int i = 0; i < connection_inputs.size(); i++)
+        auto &connections = outputs[OutputKeys::audio_]->connections;
+        if (connections.empty())
+        {
+            retireSources();
+            Reclaimer::getInstance().retire(source.release());
+        }
+        else
         {
-            auto input = connection_inputs[i];
-            if (i == sources.size())
+            // the file is opened again only when it was changed or can be opened faster now,
+            // into a new source because the previous one may be playing
+            if (source == nullptr || (name != "" && (source->path != name || !source->loaded || source->isOutdated())))
             {
-                std::unique_ptr<FileSource> f;
-                f.reset(new FileSource());
-                sources.push_back(std::move(f));
+                Reclaimer::getInstance().retire(source.release());
+                source.reset(new FileSource());
+                if (name != "")
+                    source->setFile(name);
             }
-            bool r = sources[i]->setFile(name);
+            bool r = name != "" && source->loaded;
+            fan_out.pass(connections, r ? source.get() : nullptr);
             if (r)
-            {
-                input->node->trigger((Value)((PositionableSource *)sources[i].get()), input);
-                if (sources.size() > 0)
-                    t = sources[0]->getLengthInSeconds();
-            }
+                t = source->getLengthInSeconds();
         }
 
-        connection_inputs = graph->getInputsOfOutput(outputs[OutputKeys::length_out]);
-        for (int i = 0; i < connection_inputs.size(); i++)
-        {
-            auto input = connection_inputs[i];
-            input->node->trigger((Value)((float)t), input);
-        }
+        setOutputValue(OutputKeys::length_out, t);
     }
 };
 
@@ -218,21 +293,28 @@ public:
 
 private:
     juce::Reverb::Parameters p;
-    void trigger(Value &data, [[maybe_unused]] Input *pin) override
-    {
-        if (pin == nullptr)
-            return;
-        if (sources.size() != 0)
+    void process() override
+    {
+        readNumber(InputKeys::width, p.width);
+        readNumber(InputKeys::damping, p.damping);
+        readNumber(InputKeys::dryLevel, p.dryLevel);
+        readNumber(InputKeys::freezeMode, p.freezeMode);
+        readNumber(InputKeys::roomSize, p.roomSize);
+        readNumber(InputKeys::wetLevel, p.wetLevel);
+        PositionableSource *input_source = nullptr;
+        getInput(InputKeys::audio_in, input_source);
+        if (input_source == nullptr)
         {
-            clearSources();
+            passNothing();
+            return;
         }
-        PositionableSource *input_source = std::any_cast<PositionableSource *>(data);
         passSources([&]() -> PositionableSource *
+                    { return new ReverbSource(); },
+                    [&](PositionableSource *s)
                     {
-                    auto fs = new ReverbSource();
+                    auto fs = (ReverbSource *)s;
                     fs->setSource(input_source);
-                    fs->r->setParameters(p); 
-                    return fs; });
+                    fs->r->setParameters(p); });
     }
 };
 
@@ -258,74 +340,45 @@ public:
         registerInput(InputKeys::audio_1, "audio", PinType::Audio);
         registerInput(InputKeys::audio_2, "audio", PinType::Audio);
         registerOutput(OutputKeys::audio_out, "audio", PinType::Audio);
+        selected = MathAudioSource::add;
         registerInternal(new Selector(new IntRef(selected), this, std::vector<std::string>({"Add", "Subtract", "Multiply", "Divide"}), 1));
     };
 
-    enum Operations
-    {
-        add = 1,
-        substract,
-        multiply,
-        divide
-    };
-
     void comboBoxChanged(juce::ComboBox *c) override
     {
-        switch (selected)
-        {
-        case Operations::add:
-            state.reset(new MathAudioSource::Add());
-            break;
-        case Operations::substract:
-            state.reset(new MathAudioSource::Substract());
-            break;
-        case Operations::multiply:
-            state.reset(new MathAudioSource::Multiply());
-            break;
-        case Operations::divide:
-            state.reset(new MathAudioSource::Divide());
-            break;
-        }
+        // the playing sources pick the operation up at their next block
+        operation.store(selected, std::memory_order_relaxed);
     };
+    int getScratchBuffers() override
+    {
+        // one for each input
+        return sources.empty() ? 0 : 2;
+    }
 
 private:
     int selected;
-    std::unique_ptr<MathAudioSource::State> state;
+    std::atomic<int> operation{MathAudioSource::add};
     PositionableSource *s1;
     PositionableSource *s2;
-    int counter = 0;
-    void trigger(Value &data, [[maybe_unused]] Input *pin) override
+    void process() override
     {
-        if (pin == nullptr)
-            return;
-        PositionableSource *f = std::any_cast<PositionableSource *>(data);
-        if (counter == getConnectionsNumber())
-        {
-            counter = 0;
-        }
-        clearSources();
-        if (pin == inputs[InputKeys::audio_1])
-        {
-            s1 = f;
-            counter++;
-        }
-        else if (pin == inputs[InputKeys::audio_2])
+        s1 = nullptr;
+        s2 = nullptr;
+        getInput(InputKeys::audio_1, s1);
+        getInput(InputKeys::audio_2, s2);
+        if (s1 == nullptr || s2 == nullptr)
         {
-            s2 = f;
-            counter++;
+            passNothing();
+            return;
         }
-
-        if (counter == getConnectionsNumber())
-            if (s1 != nullptr && s2 != nullptr)
-            {
-                passSources([&]() -> PositionableSource *
-                            {
-                            auto s = new MathAudioSource();
-                            s->s1 = s1;
-                            s->s2 = s2;
-                            s->state = &state;
-                            return s; });
-            }
+        passSources([&]() -> PositionableSource *
+                    { return new MathAudioSource(); },
+                    [&](PositionableSource *source)
+                    {
+                    auto s = (MathAudioSource *)source;
+                    s->s1 = s1;
+                    s->s2 = s2;
+                    s->operation = &operation; });
     }
 };
 
@@ -363,47 +416,24 @@ private:
     float phase = 0;
     float t = 1;
     F *wave = nullptr;
+    std::unique_ptr<F> default_wave{new Sine(std::vector<F **>({}))};
 
-    void trigger(Value &data, [[maybe_unused]] Input *pin) override
+    void process() override
     {
-        if (sources.size() != 0)
-        {
-            clearSources();
-        }
-        if (pin == inputs[InputKeys::frequency_])
-        {
-            frequency = std::any_cast<float>(data);
-            ((NumberInput *)input_components[InputKeys::frequency_])->update();
-        }
-        if (pin == inputs[InputKeys::seconds_])
-        {
-            t = std::any_cast<float>(data);
-            ((NumberInput *)input_components[InputKeys::seconds_])->update();
-        }
-        if (pin == inputs[InputKeys::osc_])
-        {
-            wave = std::any_cast<F *>(data);
-        }
-        else
-        {
-            wave = nullptr;
-        }
+        readNumber(InputKeys::frequency_, frequency);
+        readNumber(InputKeys::phase_, phase);
+        readNumber(InputKeys::seconds_, t);
+        wave = nullptr;
+        getInput(InputKeys::osc_, wave);
+        if (wave == nullptr)
+            wave = default_wave.get();
 
-        auto connection_inputs = graph->getInputsOfOutput(outputs[OutputKeys::length_out]);
-        for (int i = 0; i < connection_inputs.size(); i++)
-        {
-            auto input = connection_inputs[i];
-            input->node->trigger((Value)((float)t), input);
-        }
+        setOutputValue(OutputKeys::length_out, t);
 
         passSources([&]() -> PositionableSource *
-                    {
-                    if (wave == nullptr)
-                    {
-                        wave = new Sine(std::vector<F **>({}));
-                    }
-                    auto fs = new Osc(t, frequency, phase, &wave);
-                    return fs; });
+                    { return new Osc(t, frequency, phase, &wave); },
+                    [](PositionableSource *s)
+                    { ((Osc *)s)->compile(); });
     }
 };
 
@@ -433,43 +463,21 @@ public:
 private:
     PositionableSource *s1;
     PositionableSource *s2;
-    int counter = 0;
-    void trigger(Value &data, [[maybe_unused]] Input *pin) override
+    void process() override
     {
-        if (pin == nullptr)
-            return;
-        if (counter == getConnectionsNumber())
-        {
-            counter = 0;
-        }
-        if (PositionableSource *f = std::any_cast<PositionableSource *>(data))
+        s1 = nullptr;
+        s2 = nullptr;
+        getInput(InputKeys::audio_1, s1);
+        getInput(InputKeys::audio_2, s2);
+        if (s1 == nullptr || s2 == nullptr)
         {
-            if (sources.size() != 0)
-            {
-                clearSources();
-            }
-            if (pin == inputs[InputKeys::audio_1])
-            {
-                s1 = f;
-                counter++;
-            }
-            else if (pin == inputs[InputKeys::audio_2])
-            {
-                s2 = f;
-                counter++;
-            }
-
-            if (counter == getConnectionsNumber())
-
-                if (s1 != nullptr && s2 != nullptr)
-                {
-                    passSources([&]() -> PositionableSource *
-                                {
-                            auto s = new ConcatenationSource();
-                            s->setSources(std::vector<PositionableSource *>({s1, s2}));
-                            return s; });
-                }
+            passNothing();
+            return;
         }
+        passSources([&]() -> PositionableSource *
+                    { return new ConcatenationSource(); },
+                    [&](PositionableSource *s)
+                    { ((ConcatenationSource *)s)->setSources(std::vector<PositionableSource *>({s1, s2})); });
     }
 };
 
@@ -500,33 +508,21 @@ private:
     float t = 1;
     PositionableSource *audio;
 
-    void trigger(Value &data, [[maybe_unused]] Input *pin) override
+    void process() override
     {
-        if (pin == nullptr)
-            return;
-        if (sources.size() != 0)
-        {
-            clearSources();
-        }
-        if (pin == inputs[InputKeys::seconds_])
-        {
-            t = std::any_cast<float>(data);
-            ((NumberInput *)input_components[InputKeys::seconds_])->update();
-        }
-        if (pin == inputs[InputKeys::audio_])
-        {
-            audio = std::any_cast<PositionableSource *>(data);
-        }
+        readNumber(InputKeys::seconds_, t);
+        audio = nullptr;
+        getInput(InputKeys::audio_, audio);
 
         if (audio == nullptr)
         {
+            passNothing();
             return;
         }
         passSources([&]() -> PositionableSource *
-                    {
-                            auto res = new RepeatSource(t);
-                            res->source = audio;
-                            return res; });
+                    { return new RepeatSource(t); },
+                    [&](PositionableSource *s)
+                    { ((RepeatSource *)s)->source = audio; });
     }
 };
 
@@ -561,39 +557,23 @@ private:
     float start;
     PositionableSource *audio;
 
-    void trigger(Value &data, [[maybe_unused]] Input *pin) override
+    void process() override
     {
-        if (pin == nullptr)
-            return;
-        if (sources.size() != 0)
-        {
-            clearSources();
-        }
-        if (pin == inputs[InputKeys::start_])
-        {
-            start = std::any_cast<float>(data);
-            ((NumberInput *)input_components[InputKeys::start_])->update();
-        }
-        if (pin == inputs[InputKeys::duration_])
-        {
-            t = std::any_cast<float>(data);
-            ((NumberInput *)input_components[InputKeys::duration_])->update();
-        }
-        if (pin == inputs[InputKeys::audio_])
-        {
-            audio = std::any_cast<PositionableSource *>(data);
-        }
+        readNumber(InputKeys::start_, start);
+        readNumber(InputKeys::duration_, t);
+        audio = nullptr;
+        getInput(InputKeys::audio_, audio);
 
         if (audio == nullptr)
         {
+            passNothing();
             return;
         }
 
         passSources([&]() -> PositionableSource *
-                    {
-                            auto res = new TrimSource(start, t);
-            res->source = audio;
-                            return res; });
+                    { return new TrimSource(start, t); },
+                    [&](PositionableSource *s)
+                    { ((TrimSource *)s)->source = audio; });
     }
 };
 
@@ -631,32 +611,25 @@ private:
     float coefficient;
     PositionableSource *audio;
 
-    void trigger(Value &data, [[maybe_unused]] Input *pin) override
+    void process() override
     {
-        if (pin == nullptr)
-            return;
-
-        clearSources();
-
-        if (pin == inputs[InputKeys::coefficient_])
-        {
-            coefficient = std::any_cast<float>(data);
-            ((NumberInput *)input_components[InputKeys::coefficient_])->update();
-        }
-        if (pin == inputs[InputKeys::audio_])
-        {
-            audio = std::any_cast<PositionableSource *>(data);
-        }
+        readNumber(InputKeys::coefficient_, coefficient);
+        audio = nullptr;
+        getInput(InputKeys::audio_, audio);
 
         if (audio == nullptr)
         {
+            passNothing();
             return;
         }
 
         passSources([&]() -> PositionableSource *
+                    { return new ResamplingAudioSource(audio, coefficient); },
+                    [&](PositionableSource *s)
                     {
-                            auto res = new ResamplingAudioSource(audio,coefficient);
-                            return res; });
+                    auto res = (ResamplingAudioSource *)s;
+                    res->setSource(audio);
+                    res->updateCoefficient(); });
     }
 };
 
@@ -697,19 +670,120 @@ private:
     juce::IIRCoefficients coefficients;
     float f0, f1;
 
-    void trigger(Value &data, [[maybe_unused]] Input *pin) override
+    void process() override
     {
-        if (pin == nullptr)
+        readNumber(InputKeys::f0_, f0);
+        readNumber(InputKeys::f1_, f1);
+        PositionableSource *input_source = nullptr;
+        getInput(InputKeys::audio_in, input_source);
+        if (input_source == nullptr)
+        {
+            passNothing();
             return;
+        }
+        passSources([&]() -> PositionableSource *
+                    { return new FilterSource(f0, f1); },
+                    [&](PositionableSource *s)
+                    { ((FilterSource *)s)->setSource(input_source); });
+    }
+};
 
-        clearSources();
+class MixerNode : public AudioNode, public NumberInput::Listener
+{
+public:
+    // every strip has an audio, a gain and a pan input, in that order. Connecting the audio
+    // input of the last strip adds a new one, so every source gets its own gain and pan.
+    // Connections point to the pins, so the room for all strips is reserved up front
+    static constexpr int max_strips = 32;
+    enum OutputKeys
+    {
+        audio_out
+    };
+    void valueChanged() override
+    {
+        // the playing source reads these at its next block
+        for (auto &strip : strips)
+        {
+            strip->gain_value.store(strip->gain, std::memory_order_relaxed);
+            strip->pan_value.store(strip->pan, std::memory_order_relaxed);
+        }
+    }
+    MixerNode() : AudioNode(0)
+    {
+        header = NodeNames::MixerNode;
+        type_id = (int)NodeTypes::Mixer;
+        registerOutput(OutputKeys::audio_out, "audio", PinType::Audio);
+        inputs.reserve(max_strips * 3);
+        addStrip();
+        valueChanged();
+    };
+    int getScratchBuffers() override
+    {
+        // one for each mixed source
+        return sources.empty() ? 0 : mixed;
+    }
+    void inputConnected(Input *pin) override
+    {
+        if (pin->key == audioKey((int)strips.size() - 1))
+            addStrip();
+    }
+    void requireInput(int key) override
+    {
+        while ((int)strips.size() <= key / 3 && (int)strips.size() < max_strips)
+            addStrip();
+    }
+
+private:
+    struct Strip
+    {
+        float gain = 1;
+        float pan = 0;
+        std::atomic<float> gain_value{1};
+        std::atomic<float> pan_value{0};
+    };
+    // the playing source points to the values of the strips, they never move
+    std::vector<std::unique_ptr<Strip>> strips;
+    int mixed = 0;
+    static int audioKey(int strip) { return strip * 3; }
+    static int gainKey(int strip) { return strip * 3 + 1; }
+    static int panKey(int strip) { return strip * 3 + 2; }
 
-        PositionableSource *input_source = std::any_cast<PositionableSource *>(data);
+    void addStrip()
+    {
+        if ((int)strips.size() == max_strips)
+            return;
+        int i = (int)strips.size();
+        strips.push_back(std::make_unique<Strip>());
+        auto &strip = *strips.back();
+        registerInput(audioKey(i), "audio", PinType::Audio);
+        registerInput(gainKey(i), "gain", PinType::Number, new NumberInput(this, 0, 2, new FloatRef(strip.gain)));
+        registerInput(panKey(i), "pan", PinType::Number, new NumberInput(this, -1, 1, new FloatRef(strip.pan)));
+    }
+    void process() override
+    {
+        // a strip mixes the source connected last, like any other input
+        std::vector<MixerSource::Input> mix;
+        for (int i = 0; i < (int)strips.size(); i++)
+        {
+            auto &strip = *strips[(size_t)i];
+            readNumber(gainKey(i), strip.gain);
+            readNumber(panKey(i), strip.pan);
+            PositionableSource *source = nullptr;
+            getInput(audioKey(i), source);
+            if (source != nullptr)
+                mix.push_back({source, &strip.gain_value, &strip.pan_value});
+        }
+        valueChanged();
+        mixed = (int)mix.size();
+        if (mix.empty())
+        {
+            passNothing();
+            return;
+        }
         passSources([&]() -> PositionableSource *
-                    {
-                    auto fs = new FilterSource(f0,f1);
-                    fs->setSource(input_source);
-                    return fs; });
+                    { return new MixerSource(); },
+                    [&](PositionableSource *s)
+                    { ((MixerSource *)s)->setInputs(mix); });
     }
 };
 
@@ -751,6 +825,7 @@ public:
 
     void comboBoxChanged(juce::ComboBox *c) override
     {
+        Reclaimer::getInstance().retire(result.release());
         switch (selected_state)
         {
         case Operations::add:
@@ -774,36 +849,14 @@ private:
     std::unique_ptr<F> result;
     F *val1;
     F *val2;
-    int counter = 0;
 
-    void trigger(Value &data, [[maybe_unused]] Input *pin) override
+    void process() override
     {
-        if (counter == getConnectionsNumber())
-        {
-            counter = 0;
-        }
-        if (pin != nullptr)
-        {
-            if (F *f = std::any_cast<F *>(data))
-            {
-                if (pin == inputs[InputKeys::f])
-                {
-                    val1 = f;
-                    counter++;
-                }
-                else if (pin == inputs[InputKeys::g])
-                {
-                    val2 = f;
-                    counter++;
-                }
-            }
-        }
-        if (counter == getConnectionsNumber())
-            for (auto &input : graph->getInputsOfOutput(outputs[OutputKeys::h]))
-            {
-                Value source = result.get();
-                input->node->trigger(source, input);
-            }
+        val1 = nullptr;
+        val2 = nullptr;
+        getInput(InputKeys::f, val1);
+        getInput(InputKeys::g, val2);
+        setOutputValue(OutputKeys::h, result.get());
     }
 };
 
@@ -832,22 +885,10 @@ private:
     float t;
     F *fs;
 
-    void trigger(Value &data, [[maybe_unused]] Input *pin) override
+    void process() override
     {
-        int counter = 0;
-        if (pin == inputs[InputKeys::number])
-        {
-            t = std::any_cast<float>(data);
-            ((NumberInput *)input_components[InputKeys::number])->update();
-            counter++;
-        }
-        if (counter == getConnectionsNumber())
-            for (auto &input : graph->getInputsOfOutput(outputs[OutputKeys::func]))
-            {
-
-                Value source = (F *)(fs);
-                input->node->trigger(source, input);
-            }
+        readNumber(InputKeys::number, t);
+        setOutputValue(OutputKeys::func, fs);
     }
 };
 
@@ -871,6 +912,7 @@ public:
     };
     void comboBoxChanged(juce::ComboBox *c) override
     {
+        Reclaimer::getInstance().retire(waveform.release());
         switch (c->getSelectedId())
         {
         case Operations::sine:
@@ -903,25 +945,11 @@ public:
 private:
     int selected_wave;
     F *func;
-    int counter = 0;
-    void trigger(Value &data, [[maybe_unused]] Input *pin) override
+    void process() override
     {
-        if (counter == getConnectionsNumber())
-        {
-            counter = 0;
-        }
-        if (pin == inputs[InputKeys::function])
-        {
-            auto f = std::any_cast<F *>(data);
-            func = f;
-            counter++;
-        }
-        if (counter == getConnectionsNumber())
-            for (auto &input : graph->getInputsOfOutput(outputs[OutputKeys::wave_out]))
-            {
-                Value source = waveform.get();
-                input->node->trigger(source, input);
-            }
+        func = nullptr;
+        getInput(InputKeys::function, func);
+        setOutputValue(OutputKeys::wave_out, waveform.get());
     }
 };
 
@@ -951,13 +979,9 @@ public:
 
 private:
     std::unique_ptr<F> randomF;
-    void trigger(Value &data, [[maybe_unused]] Input *pin) override
+    void process() override
     {
-        for (auto &input : graph->getInputsOfOutput(outputs[OutputKeys::random]))
-        {
-            Value source = randomF.get();
-            input->node->trigger(source, input);
-        }
+        setOutputValue(OutputKeys::random, randomF.get());
     }
 };
 
@@ -993,36 +1017,14 @@ private:
     float start;
     float end;
     F *f;
-    int counter = 0;
 
-    void trigger(Value &data, [[maybe_unused]] Input *pin) override
+    void process() override
     {
-        if (counter == getConnectionsNumber())
-        {
-            counter = 0;
-        }
-        if (pin == inputs[InputKeys::function_in])
-        {
-            auto f_ = std::any_cast<F *>(data);
-            f = f_;
-            counter++;
-        }
-        if (pin == inputs[InputKeys::start_])
-        {
-            start = std::any_cast<float>(data);
-            counter++;
-        }
-        if (pin == inputs[InputKeys::end_])
-        {
-            end = std::any_cast<float>(data);
-            counter++;
-        }
-        if (counter == getConnectionsNumber())
-            for (auto &input : graph->getInputsOfOutput(outputs[OutputKeys::line_]))
-            {
-                Value source = line.get();
-                input->node->trigger(source, input);
-            }
+        f = nullptr;
+        getInput(InputKeys::function_in, f);
+        readNumber(InputKeys::start_, start);
+        readNumber(InputKeys::end_, end);
+        setOutputValue(OutputKeys::line_, line.get());
     }
 };
 
@@ -1054,37 +1056,13 @@ private:
     std::unique_ptr<F> result;
     F *val1;
     F *val2;
-    int counter = 0;
-    void trigger(Value &data, [[maybe_unused]] Input *pin) override
+    void process() override
     {
-        if (counter == getConnectionsNumber())
-        {
-            counter = 0;
-        }
-        if (pin != nullptr)
-        {
-            if (F *f = std::any_cast<F *>(data))
-            {
-                if (pin == inputs[InputKeys::f])
-                {
-                    val1 = f;
-                    counter++;
-                }
-                else if (pin == inputs[InputKeys::g])
-                {
-                    val2 = f;
-                    counter++;
-                }
-            }
-        }
-        if (counter == getConnectionsNumber())
-            for (auto &input : graph->getInputsOfOutput(outputs[OutputKeys::h]))
-            {
-                if (result.get() == nullptr)
-                    return;
-                Value source = result.get();
-                input->node->trigger(source, input);
-            }
+        val1 = nullptr;
+        val2 = nullptr;
+        getInput(InputKeys::f, val1);
+        getInput(InputKeys::g, val2);
+        setOutputValue(OutputKeys::h, result.get());
     }
 };
 
@@ -1150,33 +1128,14 @@ private:
     float val1 = 0;
     float val2 = 0;
     float res;
-    void trigger(Value &data, [[maybe_unused]] Input *pin) override
+    void process() override
     {
-        int counter = 0;
-        if (pin != nullptr)
-        {
-            if (float f = std::any_cast<float>(data))
-            {
-                if (pin == inputs[InputKeys::number_1])
-                {
-                    val1 = f;
-                    input_components[InputKeys::number_1]->update();
-                    counter++;
-                }
-                else if (pin == inputs[InputKeys::number_2])
-                {
-                    val2 = f;
-                    ((NumberInput *)input_components[InputKeys::number_2])->update();
-                    counter++;
-                }
-            }
-        }
-        if (counter == getConnectionsNumber())
-            for (auto &input : graph->getInputsOfOutput(outputs[OutputKeys::number_out]))
-            {
-                Value source = (float)state->operation(val1, val2);
-                input->node->trigger(source, input);
-            }
+        readNumber(InputKeys::number_1, val1);
+        readNumber(InputKeys::number_2, val2);
+        if (state == nullptr)
+            return;
+        res = state->operation(val1, val2);
+        setOutputValue(OutputKeys::number_out, res);
     }
 };
 
@@ -1193,12 +1152,6 @@ public:
     };
     void valueChanged() override
     {
-
-        for (auto &input : graph->getInputsOfOutput(outputs[OutputKeys::number_out]))
-        {
-            Value source = value;
-            input->node->trigger(source, input);
-        }
     }
     NumberNode()
     {
@@ -1211,22 +1164,9 @@ public:
 private:
     float value = 0;
 
-    void trigger(Value &data, [[maybe_unused]] Input *pin) override
+    void process() override
     {
-        int counter = 0;
-        if (pin != nullptr)
-        {
-            if (float f = std::any_cast<float>(data))
-            {
-                if (pin == inputs[InputKeys::number_])
-                {
-                    value = f;
-                    input_components[InputKeys::number_]->update();
-                    counter++;
-                }
-            }
-        }
-        if (counter == getConnectionsNumber())
-            valueChanged();
+        readNumber(InputKeys::number_, value);
+        setOutputValue(OutputKeys::number_out, value);
     }
 };
\ No newline at end of file
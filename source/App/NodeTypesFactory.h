@@ -26,6 +26,7 @@ public:
         factories[NodeTypes::TrimNode] = new NodeCreateCommand<TrimNode>;
         factories[NodeTypes::ResamplingNode] = new NodeCreateCommand<ResamplingNode>;
         factories[NodeTypes::FilterNode] = new NodeCreateCommand<BandPassNode>;
+        factories[NodeTypes::Mixer] = new NodeCreateCommand<MixerNode>;
     }
 
     EditorNode *getNode(int type_id) override
@@ -20,7 +20,8 @@ enum class NodeTypes
     RepeatNode,
     TrimNode,
     ResamplingNode,
-    FilterNode
+    FilterNode,
+    Mixer
 };
 
 struct NodeNames
@@ -43,6 +44,7 @@ struct NodeNames
     static const std::string TrimNode;
     static const std::string ResamplingNode;
     static const std::string FilterNode;
+    static const std::string MixerNode;
 };
 const std::string NodeNames::OutputNode = "Output";
 const std::string NodeNames::FileReader = "File Reader";
@@ -61,4 +63,5 @@ const std::string NodeNames::ConcatenateFunction = "Function Concatenate";
 const std::string NodeNames::RepeatNode = "Repeat";
 const std::string NodeNames::TrimNode = "Trim";
 const std::string NodeNames::ResamplingNode = "Resampling";
-const std::string NodeNames::FilterNode = "Band Pass Filter";
\ No newline at end of file
+const std::string NodeNames::FilterNode = "Band Pass Filter";
+const std::string NodeNames::MixerNode = "Mixer";
\ No newline at end of file
@@ -0,0 +1,219 @@
+#pragma once
+#include <JuceHeader.h>
+#include "RecoverableNodeGraph.h"
+#include "NodeTypes.h"
+#include <fstream>
+
+// Opens a project without blocking the message thread. The file is parsed on a worker,
+// the nodes are created on the message thread a few at a time, and the audio files the
+// project plays from the clip cache are decoded in parallel. The editor can be used as
+// soon as the graph is there, while the files are still being decoded.
+class ProjectLoader : private juce::Timer, private juce::AsyncUpdater
+{
+public:
+    ProjectLoader(RecoverableNodeGraph *g, TypesRecoverFactory *f, double rate) : graph(g), factory(f), sample_rate(rate)
+    {
+    }
+    ~ProjectLoader() override
+    {
+        onProgress = nullptr;
+        cancel();
+        // the jobs still running post updates to this loader
+        pool.removeAllJobs(true, -1);
+    }
+    void load(juce::String path)
+    {
+        cancel();
+        current = std::make_shared<Load>();
+        stage = parsing;
+        progress = 0;
+        pool.addJob([this, path, load = current]()
+                    {
+                        std::ifstream file(path.getCharPointer());
+                        if (!file.is_open())
+                        {
+                            std::cerr << "Error: Unable to open file." << std::endl;
+                            load->failed = true;
+                        }
+                        else
+                            file >> load->info;
+                        load->parsed = true;
+                        triggerAsyncUpdate(); });
+        startTimer(interval);
+        changed();
+    }
+    // stops what is left to do without waiting, a graph that isn't complete yet is
+    // cleared. Files already being decoded finish in the background, their load is dropped
+    void cancel()
+    {
+        if (current != nullptr)
+            current->cancelled = true;
+        current = nullptr;
+        pool.removeAllJobs(false, 0);
+        cancelPendingUpdate();
+        stopTimer();
+        if (stage == building)
+        {
+            cleared();
+            graph->recover(GraphInfo(), factory);
+        }
+        finish();
+    }
+    bool isLoading()
+    {
+        return stage != idle;
+    }
+    // 0 to 1 over parsing, building and decoding
+    double getProgress()
+    {
+        return progress;
+    }
+    juce::String getStatus()
+    {
+        switch (stage)
+        {
+        case parsing:
+            return "Reading project";
+        case building:
+            return "Creating nodes " + juce::String(next_node) + "/" + juce::String((int)ids.size());
+        case decoding:
+            return "Decoding files " + juce::String(current->decoded.load()) + "/" + juce::String((int)files.size());
+        default:
+            return {};
+        }
+    }
+    // called on the message thread whenever the progress or the stage changes
+    std::function<void()> onProgress;
+    // called on the message thread before the graph is cleared, nothing may play it then
+    std::function<void()> onClear;
+
+private:
+    enum Stage
+    {
+        idle,
+        parsing,
+        building,
+        decoding
+    };
+    // nodes created per timer tick, the editor stays responsive in between
+    static constexpr int batch_size = 32;
+    static constexpr int interval = 10;
+
+    // what the jobs of one load share with the message thread. A cancelled load is
+    // dropped by the loader, jobs still running keep it alive and their results are ignored
+    struct Load
+    {
+        GraphInfo info;
+        std::atomic<bool> parsed{false};
+        std::atomic<bool> failed{false};
+        std::atomic<bool> cancelled{false};
+        std::atomic<int> decoded{0};
+    };
+
+    RecoverableNodeGraph *graph;
+    TypesRecoverFactory *factory;
+    double sample_rate;
+    juce::ThreadPool pool{juce::jlimit(1, 8, juce::SystemStats::getNumCpus())};
+    Stage stage = idle;
+    double progress = 0;
+    std::shared_ptr<Load> current;
+    std::vector<int> ids;
+    int next_node = 0;
+    std::vector<juce::File> files;
+
+    // the file was parsed, or a cancelled load finished parsing
+    void handleAsyncUpdate() override
+    {
+        if (stage != parsing || current == nullptr || !current->parsed)
+            return;
+        if (current->failed)
+        {
+            finish();
+            return;
+        }
+        auto &info = current->info;
+        ids.clear();
+        for (auto &[id, node_info] : info.nodes)
+            ids.push_back(id);
+        next_node = 0;
+        cleared();
+        graph->beginRecover(info);
+        stage = building;
+        changed();
+    }
+    void timerCallback() override
+    {
+        if (stage == building)
+        {
+            int end = std::min((int)ids.size(), next_node + batch_size);
+            graph->recoverNodes(current->info, std::vector<int>(ids.begin() + next_node, ids.begin() + end), factory);
+            next_node = end;
+            if (next_node == (int)ids.size())
+            {
+                graph->recoverConnections(current->info);
+                startDecoding();
+            }
+            changed();
+        }
+        else if (stage == decoding)
+        {
+            if (current->decoded.load() == (int)files.size())
+                finish();
+            changed();
+        }
+    }
+    // the files of every file reader, each decoded by its own job
+    void startDecoding()
+    {
+        stage = decoding;
+        files.clear();
+        for (auto &[id, node_info] : current->info.nodes)
+        {
+            if (node_info.type_id == (int)NodeTypes::FileReader && !node_info.internal_values.empty() && node_info.internal_values[0] != "")
+                files.push_back(juce::File(node_info.internal_values[0]));
+        }
+        current->info = GraphInfo();
+        for (auto &f : files)
+        {
+            pool.addJob([f, rate = sample_rate, load = current]()
+                        {
+                            if (!load->cancelled)
+                                FileSource::prefetch(f, rate);
+                            load->decoded++; });
+        }
+    }
+    void finish()
+    {
+        stopTimer();
+        stage = idle;
+        progress = 1;
+        ids.clear();
+        files.clear();
+        current = nullptr;
+        changed();
+    }
+    void cleared()
+    {
+        if (onClear != nullptr)
+            onClear();
+    }
+    void changed()
+    {
+        switch (stage)
+        {
+        case parsing:
+            progress = 0.05;
+            break;
+        case building:
+            progress = 0.1 + 0.3 * next_node / std::max<size_t>(1, ids.size());
+            break;
+        case decoding:
+            progress = 0.4 + 0.6 * current->decoded.load() / std::max<size_t>(1, files.size());
+            break;
+        default:
+            break;
+        }
+        if (onProgress != nullptr)
+            onProgress();
+    }
+};
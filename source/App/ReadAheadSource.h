@@ -0,0 +1,287 @@
+#pragma once
+#include <JuceHeader.h>
+#include "ReadAheadThreads.h"
+
+// Reads a stream ahead of playback on one of the shared reading threads. How far it
+// reads ahead follows how fast the stream is played and how long reads take, so a
+// resampled stream or a slow network drive gets a larger buffer and a clip read from a
+// fast disk a small one. The buffers of all streams together stay under the memory cap
+// of ReadAheadThreads.
+class ReadAheadSource : public juce::PositionableAudioSource, private juce::TimeSliceClient
+{
+public:
+    struct Counters
+    {
+        // samples the buffer holds at most and holds now
+        int capacity;
+        int buffered;
+        // blocks that were played before they were read
+        int underruns;
+        // samples played per second and time a read takes
+        double consumption_rate;
+        double read_latency_ms;
+    };
+    ReadAheadSource(juce::PositionableAudioSource *s, int num_channels) : source(s), channels(juce::jmax(2, num_channels))
+    {
+        resize(initial_capacity);
+        chunk.setSize(channels, chunk_size);
+        thread = ReadAheadThreads::getInstance().acquire();
+        thread->addTimeSliceClient(this);
+    }
+    ~ReadAheadSource() override
+    {
+        thread->removeTimeSliceClient(this);
+        ReadAheadThreads::getInstance().allocated(-(juce::int64)capacity * channels * sizeof(float));
+    }
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override
+    {
+        source->prepareToPlay(samplesPerBlockExpected, sampleRate);
+    }
+    void releaseResources() override
+    {
+        source->releaseResources();
+    }
+    // never waits for the reading thread, what isn't read yet plays as silence
+    void getNextAudioBlock(const juce::AudioSourceChannelInfo &bufferToFill) override
+    {
+        int n = bufferToFill.numSamples;
+        int available = 0;
+        bool underran = false;
+        {
+            const juce::SpinLock::ScopedLockType lock(mutex);
+            auto position = play_position.load(std::memory_order_relaxed);
+            if (position >= buffered_start && position < buffered_end)
+                available = (int)juce::jmin<juce::int64>(n, buffered_end - position);
+            for (int channel = 0; channel < bufferToFill.buffer->getNumChannels(); ++channel)
+            {
+                auto output = bufferToFill.buffer->getWritePointer(channel, bufferToFill.startSample);
+                if (channel < channels)
+                    copyFromRing(*ring, channel, position, output, available);
+                juce::FloatVectorOperations::clear(output + (channel < channels ? available : 0), n - (channel < channels ? available : 0));
+            }
+            if (available < n && position < source->getTotalLength())
+            {
+                underran = true;
+                underruns.fetch_add(1, std::memory_order_relaxed);
+                ReadAheadThreads::getInstance().underrun();
+            }
+            play_position.store(position + n, std::memory_order_relaxed);
+        }
+        consumed.fetch_add(n, std::memory_order_relaxed);
+        // otherwise the reading thread comes back when the buffer needs it, see useTimeSlice
+        if (underran)
+            thread->notify();
+    }
+    void setNextReadPosition(juce::int64 p) override
+    {
+        {
+            const juce::SpinLock::ScopedLockType lock(mutex);
+            play_position.store(p, std::memory_order_relaxed);
+            // a seek inside the buffered part keeps it
+            if (p < buffered_start || p > buffered_end)
+            {
+                buffered_start = buffered_end = p;
+                generation++;
+            }
+        }
+        thread->notify();
+    }
+    juce::int64 getNextReadPosition() const override
+    {
+        return play_position.load(std::memory_order_relaxed);
+    }
+    juce::int64 getTotalLength() const override
+    {
+        return source->getTotalLength();
+    }
+    bool isLooping() const override
+    {
+        return false;
+    }
+    Counters getCounters()
+    {
+        const juce::SpinLock::ScopedLockType lock(mutex);
+        return {capacity, (int)juce::jmax<juce::int64>(0, buffered_end - juce::jmax(buffered_start, play_position.load(std::memory_order_relaxed))),
+                underruns.load(std::memory_order_relaxed), consumption_rate.load(std::memory_order_relaxed),
+                read_latency_ms.load(std::memory_order_relaxed)};
+    }
+
+private:
+    static constexpr int chunk_size = 8192;
+    static constexpr int initial_capacity = 32768;
+    static constexpr int min_capacity = 2 * chunk_size;
+    static constexpr int max_capacity = 1 << 21;
+    // longest wait between two time slices, while nothing is played
+    static constexpr int idle_wait = 50;
+
+    std::unique_ptr<juce::PositionableAudioSource> source;
+    int channels;
+    juce::TimeSliceThread *thread;
+
+    // the ring holds the samples [buffered_start, buffered_end) of the stream,
+    // sample p at index p % capacity
+    juce::SpinLock mutex;
+    // only replaced by the reading thread, under the lock
+    std::unique_ptr<juce::AudioBuffer<float>> ring;
+    int capacity = 0;
+    juce::int64 buffered_start = 0;
+    juce::int64 buffered_end = 0;
+    std::atomic<juce::int64> play_position{0};
+    // changes on every seek, so a read that was started before it is dropped
+    int generation = 0;
+
+    // counted by the audio thread, measured by the reading thread
+    std::atomic<juce::int64> consumed{0};
+    std::atomic<int> underruns{0};
+    std::atomic<double> consumption_rate{0};
+    std::atomic<double> read_latency_ms{0};
+
+    // only used by the reading thread
+    juce::AudioBuffer<float> chunk;
+    juce::int64 last_consumed = 0;
+    int last_underruns = 0;
+    double last_measured = 0;
+    double safety = 1;
+
+    static void copyFromRing(const juce::AudioBuffer<float> &from_ring, int channel, juce::int64 from, float *output, int n)
+    {
+        int size = from_ring.getNumSamples();
+        int index = (int)(from % size);
+        int first = juce::jmin(n, size - index);
+        juce::FloatVectorOperations::copy(output, from_ring.getReadPointer(channel, index), first);
+        juce::FloatVectorOperations::copy(output + first, from_ring.getReadPointer(channel), n - first);
+    }
+    static void copyToRing(juce::AudioBuffer<float> &to_ring, int channel, juce::int64 to, const float *input, int n)
+    {
+        int size = to_ring.getNumSamples();
+        int index = (int)(to % size);
+        int first = juce::jmin(n, size - index);
+        juce::FloatVectorOperations::copy(to_ring.getWritePointer(channel, index), input, first);
+        juce::FloatVectorOperations::copy(to_ring.getWritePointer(channel), input + first, n - first);
+    }
+    // the time until this stream needs the thread again. TimeSliceThread calls the client
+    // that asked for the shortest wait first, so the stream that runs out soonest is read first
+    int useTimeSlice() override
+    {
+        adapt();
+        juce::int64 from;
+        int wanted;
+        int read_generation;
+        int buffered;
+        {
+            const juce::SpinLock::ScopedLockType lock(mutex);
+            // what was played is free again
+            buffered_start = juce::jlimit(buffered_start, buffered_end, play_position.load(std::memory_order_relaxed));
+            from = buffered_end;
+            buffered = (int)(buffered_end - buffered_start);
+            wanted = (int)std::min({(juce::int64)chunk_size,
+                                    capacity - (juce::int64)buffered,
+                                    source->getTotalLength() - buffered_end});
+            read_generation = generation;
+        }
+        if (wanted <= 0)
+            return waitWhileFull(from < source->getTotalLength() ? chunk_size - (capacity - buffered) : -1);
+        // the disk is read without holding the lock, the audio thread only waits for the copy
+        double started = juce::Time::getMillisecondCounterHiRes();
+        source->setNextReadPosition(from);
+        source->getNextAudioBlock(juce::AudioSourceChannelInfo(&chunk, 0, wanted));
+        double took = juce::Time::getMillisecondCounterHiRes() - started;
+        double latency = read_latency_ms.load(std::memory_order_relaxed);
+        read_latency_ms.store(latency == 0 ? took : latency * 0.8 + took * 0.2, std::memory_order_relaxed);
+        {
+            const juce::SpinLock::ScopedLockType lock(mutex);
+            if (read_generation != generation || from != buffered_end)
+                return 0;
+            for (int channel = 0; channel < channels; ++channel)
+                copyToRing(*ring, channel, from, chunk.getReadPointer(channel), wanted);
+            buffered_end += wanted;
+        }
+        return waitWhileFilling(buffered + wanted);
+    }
+    // the buffer has no room for a chunk: until playback has freed the missing samples,
+    // -1 when the stream is read to its end
+    int waitWhileFull(int missing)
+    {
+        double rate = consumption_rate.load(std::memory_order_relaxed);
+        if (missing < 0 || rate <= 0)
+            return idle_wait;
+        return juce::jlimit(1, idle_wait, (int)(missing * 1000.0 / rate));
+    }
+    // the buffer has room: at once while it holds less than a few reads take, otherwise a
+    // part of the time the audio of one read lasts, the fuller the buffer the larger
+    int waitWhileFilling(int buffered)
+    {
+        double rate = consumption_rate.load(std::memory_order_relaxed);
+        if (rate <= 0)
+            return 1;
+        double latency = read_latency_ms.load(std::memory_order_relaxed);
+        if (buffered * 1000.0 / rate < 4 * latency)
+            return 0;
+        // reads still add audio faster than it is played, so the buffer fills up
+        double chunk_ms = chunk_size * 1000.0 / rate;
+        return juce::jlimit(0, 20, (int)((chunk_ms - latency) * buffered / capacity));
+    }
+    // sizes the buffer to hold the audio played while a few reads are in flight
+    void adapt()
+    {
+        double now = juce::Time::getMillisecondCounterHiRes();
+        if (now - last_measured < 250)
+            return;
+        auto c = consumed.load(std::memory_order_relaxed);
+        double rate = last_measured == 0 ? 0 : (c - last_consumed) * 1000.0 / (now - last_measured);
+        consumption_rate.store(consumption_rate.load(std::memory_order_relaxed) * 0.5 + rate * 0.5, std::memory_order_relaxed);
+        last_consumed = c;
+        last_measured = now;
+        // every underrun asks for more, it is given back slowly while playback is smooth
+        int u = underruns.load(std::memory_order_relaxed);
+        safety = u != last_underruns ? juce::jmin(8.0, safety * 1.5) : juce::jmax(1.0, safety * 0.99);
+        last_underruns = u;
+
+        double seconds = (4 * read_latency_ms.load(std::memory_order_relaxed) / 1000.0 + 0.1) * safety;
+        int wanted = juce::jlimit(min_capacity, max_capacity, (int)(consumption_rate.load(std::memory_order_relaxed) * seconds) + chunk_size);
+        wanted = ReadAheadThreads::getInstance().limit(wanted, capacity, channels);
+        // only large changes are worth moving the buffered audio
+        if (wanted > capacity * 5 / 4 || wanted < capacity / 2)
+            resize(wanted);
+    }
+    // called on the reading thread, the only one that writes the ring, so the buffered
+    // samples can be copied without the lock. The audio thread only waits for the swap
+    void resize(int samples)
+    {
+        auto resized = std::make_unique<juce::AudioBuffer<float>>(channels, samples);
+        juce::int64 start, end;
+        int resize_generation;
+        {
+            const juce::SpinLock::ScopedLockType lock(mutex);
+            start = juce::jlimit(buffered_start, buffered_end, play_position.load(std::memory_order_relaxed));
+            end = buffered_end;
+            resize_generation = generation;
+        }
+        // keeps what wasn't played yet, as much of it as fits
+        int kept = capacity == 0 ? 0 : (int)juce::jmin<juce::int64>(end - start, samples);
+        for (int channel = 0; channel < channels && kept > 0; ++channel)
+            copyRange(*ring, *resized, channel, start, kept);
+        {
+            const juce::SpinLock::ScopedLockType lock(mutex);
+            ReadAheadThreads::getInstance().allocated(((juce::int64)samples - capacity) * channels * sizeof(float));
+            std::swap(ring, resized);
+            capacity = samples;
+            // a seek in the meantime dropped the buffered samples
+            if (generation == resize_generation)
+            {
+                buffered_start = juce::jlimit(start, start + kept, play_position.load(std::memory_order_relaxed));
+                buffered_end = start + kept;
+            }
+        }
+        // the old buffer is freed here, outside the lock
+    }
+    static void copyRange(const juce::AudioBuffer<float> &from_ring, juce::AudioBuffer<float> &to_ring, int channel, juce::int64 start, int n)
+    {
+        int size = to_ring.getNumSamples();
+        auto to = to_ring.getWritePointer(channel);
+        int index = (int)(start % size);
+        int first = juce::jmin(n, size - index);
+        copyFromRing(from_ring, channel, start, to + index, first);
+        copyFromRing(from_ring, channel, start + first, to, n - first);
+    }
+};
@@ -0,0 +1,74 @@
+#pragma once
+#include <JuceHeader.h>
+
+// The threads that read streamed files ahead of playback, shared by every FileSource.
+// Their number doesn't grow with the project. Each thread calls next whichever of its
+// sources asked to be called soonest, and a ReadAheadSource asks for a wait that follows how
+// many milliseconds of audio it has buffered at the rate it is played, so the source
+// closest to running out is read first.
+class ReadAheadThreads
+{
+public:
+    static ReadAheadThreads &getInstance()
+    {
+        static ReadAheadThreads instance;
+        return instance;
+    }
+    ~ReadAheadThreads()
+    {
+        for (auto &t : threads)
+            t->stopThread(1000);
+    }
+    // the thread with the fewest sources, a source keeps it until it is removed from it
+    juce::TimeSliceThread *acquire()
+    {
+        auto least = std::min_element(threads.begin(), threads.end(), [](const auto &a, const auto &b)
+                                      { return a->getNumClients() < b->getNumClients(); });
+        if (!(*least)->isThreadRunning())
+            (*least)->startThread();
+        return least->get();
+    }
+
+    // the read-ahead a stream may grow to from its current size, streams below the
+    // minimum are never held back by the cap
+    int limit(int wanted, int current, int channels)
+    {
+        juce::int64 spare = memory_cap - allocated_bytes.load(std::memory_order_relaxed);
+        juce::int64 most = current + juce::jmax<juce::int64>(0, spare) / ((juce::int64)channels * sizeof(float));
+        return (int)juce::jmin<juce::int64>(wanted, juce::jmax<juce::int64>(most, juce::jmin(wanted, current)));
+    }
+    void allocated(juce::int64 bytes)
+    {
+        allocated_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+    void underrun()
+    {
+        underruns.fetch_add(1, std::memory_order_relaxed);
+    }
+    void setMemoryCap(juce::int64 bytes)
+    {
+        memory_cap = bytes;
+    }
+    // totals over every stream, for monitoring
+    juce::int64 getAllocatedBytes()
+    {
+        return allocated_bytes.load(std::memory_order_relaxed);
+    }
+    int getUnderruns()
+    {
+        return underruns.load(std::memory_order_relaxed);
+    }
+
+private:
+    ReadAheadThreads()
+    {
+        // reading is bound by the disk, a couple of threads keep it busy
+        int count = juce::jlimit(1, 4, juce::SystemStats::getNumCpus() / 2);
+        for (int i = 0; i < count; i++)
+            threads.push_back(std::make_unique<juce::TimeSliceThread>("audio file reading thread " + juce::String(i)));
+    }
+    std::vector<std::unique_ptr<juce::TimeSliceThread>> threads;
+    std::atomic<juce::int64> allocated_bytes{0};
+    std::atomic<int> underruns{0};
+    std::atomic<juce::int64> memory_cap{(juce::int64)256 * 1024 * 1024};
+};
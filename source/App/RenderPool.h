@@ -0,0 +1,223 @@
+#pragma once
+#include <JuceHeader.h>
+
+// Renders independent sources of one block on worker threads. Every worker has its own
+// lock-free queue, render hands the jobs to the queues and renders the first one itself.
+// A thread waiting for its jobs takes queued jobs from any queue instead, so a block never
+// waits for a job nobody has started and in the worst case renders serially. The workers
+// run at real-time priority and stay awake for a while after their last job, so a playing
+// device doesn't wake them every block. Nested calls from inside a job are allowed,
+// rendering never allocates.
+class RenderPool
+{
+public:
+    struct Job
+    {
+        juce::AudioSource *source;
+        juce::AudioSourceChannelInfo info;
+    };
+    static RenderPool &getInstance()
+    {
+        static RenderPool instance;
+        return instance;
+    }
+    ~RenderPool()
+    {
+        for (auto &w : workers)
+            w->stopThread(1000);
+    }
+    // returns when every job is rendered
+    void render(Job *jobs, int count)
+    {
+        if (count <= 1 || workers.empty())
+        {
+            for (int i = 0; i < count; i++)
+                jobs[i].source->getNextAudioBlock(jobs[i].info);
+            return;
+        }
+        Fork fork;
+        fork.jobs = jobs;
+        fork.remaining.store(count, std::memory_order_relaxed);
+        auto first = next_queue.fetch_add((unsigned)count - 1, std::memory_order_relaxed);
+        for (int i = 1; i < count; i++)
+        {
+            auto &worker = *workers[(first + (unsigned)i) % workers.size()];
+            // a full queue means the workers are far behind, the job is rendered here
+            if (!worker.queue.push({&fork, i}))
+                run({&fork, i});
+        }
+        wakeSleeping();
+        run({&fork, 0});
+        // the jobs left are queued or running. Queued jobs are taken here, jobs of other
+        // calls too, they belong to the same block
+        while (fork.remaining.load(std::memory_order_acquire) > 0)
+        {
+            Task task;
+            if (steal(task))
+                run(task);
+        }
+    }
+
+private:
+    // one call to render, on the stack of the calling thread
+    struct Fork
+    {
+        Job *jobs = nullptr;
+        std::atomic<int> remaining{0};
+    };
+    struct Task
+    {
+        Fork *fork = nullptr;
+        int index = 0;
+    };
+    // bounded queue for several producers and consumers, every cell carries a sequence
+    // number that tells whether it is free or holds a task for the current round
+    class Queue
+    {
+    public:
+        Queue()
+        {
+            for (size_t i = 0; i < capacity; i++)
+                cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        bool push(Task task)
+        {
+            size_t position = tail.load(std::memory_order_relaxed);
+            Cell *cell;
+            while (true)
+            {
+                cell = &cells[position & (capacity - 1)];
+                auto sequence = cell->sequence.load(std::memory_order_acquire);
+                auto difference = (std::ptrdiff_t)sequence - (std::ptrdiff_t)position;
+                if (difference == 0 && tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    break;
+                if (difference < 0)
+                    return false;
+                if (difference > 0)
+                    position = tail.load(std::memory_order_relaxed);
+            }
+            cell->task = task;
+            cell->sequence.store(position + 1, std::memory_order_release);
+            return true;
+        }
+        bool pop(Task &task)
+        {
+            size_t position = head.load(std::memory_order_relaxed);
+            Cell *cell;
+            while (true)
+            {
+                cell = &cells[position & (capacity - 1)];
+                auto sequence = cell->sequence.load(std::memory_order_acquire);
+                auto difference = (std::ptrdiff_t)sequence - (std::ptrdiff_t)(position + 1);
+                if (difference == 0 && head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    break;
+                if (difference < 0)
+                    return false;
+                if (difference > 0)
+                    position = head.load(std::memory_order_relaxed);
+            }
+            task = cell->task;
+            cell->sequence.store(position + capacity, std::memory_order_release);
+            return true;
+        }
+
+    private:
+        static constexpr size_t capacity = 256;
+        struct Cell
+        {
+            std::atomic<size_t> sequence;
+            Task task;
+        };
+        std::array<Cell, capacity> cells;
+        std::atomic<size_t> head{0};
+        std::atomic<size_t> tail{0};
+    };
+    class Worker : public juce::Thread
+    {
+    public:
+        Worker(RenderPool &_pool) : juce::Thread("render worker"), pool(_pool){};
+        void run() override
+        {
+            auto last_job = juce::Time::getMillisecondCounter();
+            while (!threadShouldExit())
+            {
+                Task task;
+                if (queue.pop(task) || pool.steal(task))
+                {
+                    pool.run(task);
+                    last_job = juce::Time::getMillisecondCounter();
+                    continue;
+                }
+                if (juce::Time::getMillisecondCounter() - last_job < idle_ms)
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+                // pairs with the fence in wakeSleeping, either the worker sees the new job
+                // or render sees that it sleeps
+                sleeping.store(true, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (queue.pop(task) || pool.steal(task))
+                {
+                    sleeping.store(false, std::memory_order_relaxed);
+                    pool.run(task);
+                }
+                else
+                {
+                    wait(-1);
+                    sleeping.store(false, std::memory_order_relaxed);
+                }
+                last_job = juce::Time::getMillisecondCounter();
+            }
+        }
+        Queue queue;
+        std::atomic<bool> sleeping{false};
+
+    private:
+        RenderPool &pool;
+    };
+
+    RenderPool()
+    {
+        int count = juce::jlimit(0, 7, juce::SystemStats::getNumCpus() - 1);
+        for (int i = 0; i < count; i++)
+            workers.push_back(std::make_unique<Worker>(*this));
+        // the workers steal from each other, so every queue exists before one runs
+        for (auto &w : workers)
+        {
+            if (!w->startRealtimeThread(juce::Thread::RealtimeOptions{}))
+                w->startThread(juce::Thread::Priority::highest);
+        }
+    }
+    static void run(Task task)
+    {
+        auto &job = task.fork->jobs[task.index];
+        job.source->getNextAudioBlock(job.info);
+        // the last access to the fork, render may return right after it
+        task.fork->remaining.fetch_sub(1, std::memory_order_acq_rel);
+    }
+    bool steal(Task &task)
+    {
+        for (auto &w : workers)
+        {
+            if (w->queue.pop(task))
+                return true;
+        }
+        return false;
+    }
+    // only workers that went to sleep are notified, awake ones find the jobs themselves
+    void wakeSleeping()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        for (auto &w : workers)
+        {
+            if (w->sleeping.load(std::memory_order_relaxed))
+                w->notify();
+        }
+    }
+
+    // longer than a device block, so workers don't sleep between the blocks of a playing device
+    static constexpr juce::uint32 idle_ms = 50;
+    std::atomic<unsigned> next_queue{0};
+    std::vector<std::unique_ptr<Worker>> workers;
+};
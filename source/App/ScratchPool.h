@@ -0,0 +1,143 @@
+#pragma once
+#include <JuceHeader.h>
+
+// Aligned scratch buffers shared by every source. A source takes buffers for one block
+// and gives them back as soon as it has read them, so subtrees rendered one after
+// another reuse the same, recently touched memory. The pool is sized for a whole tree
+// before the tree is published and never allocates while rendering.
+class ScratchPool
+{
+public:
+    struct Buffers;
+    struct Buffer
+    {
+        Buffer(Buffers &_owner, int channel_count, int samples) : owner(_owner), num_channels(channel_count), num_samples(samples), channels(channel_count)
+        {
+            // every channel starts on a cache line, which also satisfies any SIMD alignment
+            int stride = (samples + 15) / 16 * 16;
+            memory.reset(new float[stride * num_channels + 16]);
+            auto aligned = (float *)(((uintptr_t)memory.get() + 63) & ~(uintptr_t)63);
+            for (int c = 0; c < num_channels; c++)
+                channels[c] = aligned + c * stride;
+            audio.setDataToReferTo(channels.data(), num_channels, samples);
+        }
+        // a buffer goes back to the set it was taken from
+        Buffers &owner;
+        const int num_channels;
+        const int num_samples;
+        juce::AudioBuffer<float> audio;
+        std::unique_ptr<float[]> memory;
+        std::vector<float *> channels;
+    };
+    // buffers of one size. A set only grows up to the capacity of its free stack, a
+    // larger tree or block gets a new set
+    struct Buffers
+    {
+        Buffers(int _capacity, int _samples, int _channels) : capacity(_capacity), samples(_samples), channels(_channels), free((size_t)_capacity) {}
+        const int capacity;
+        const int samples;
+        const int channels;
+        juce::SpinLock mutex;
+        std::vector<Buffer *> free;
+        int top = 0;
+        // only used on the message thread
+        std::vector<std::unique_ptr<Buffer>> buffers;
+    };
+    static ScratchPool &getInstance()
+    {
+        static ScratchPool instance;
+        return instance;
+    }
+    ~ScratchPool()
+    {
+        delete current.load();
+    }
+    // called on the message thread before a tree is published, `count` is the most buffers
+    // its sources take at once. Returns the set that was replaced, or nullptr. The audio thread
+    // may still hold its buffers, so it is retired like a source
+    Buffers *reserve(int count, int samples, int channels = 2)
+    {
+        auto buffers = current.load(std::memory_order_relaxed);
+        if (buffers == nullptr || count > buffers->capacity || samples > buffers->samples || channels > buffers->channels)
+        {
+            int capacity = std::max(count * 2, 16);
+            if (buffers != nullptr)
+            {
+                samples = std::max(samples, buffers->samples);
+                channels = std::max(channels, buffers->channels);
+                capacity = std::max(capacity, buffers->capacity);
+            }
+            return current.exchange(fill(new Buffers(capacity, samples, channels), count), std::memory_order_acq_rel);
+        }
+        fill(buffers, count);
+        return nullptr;
+    }
+    // the pool is sized for the tree when it is built, so running out means a source takes
+    // more buffers than its node counted or the block is larger than the device announced
+    Buffer *acquire(int num_channels, int length)
+    {
+        auto buffers = current.load(std::memory_order_acquire);
+        Buffer *buffer = nullptr;
+        if (buffers != nullptr && num_channels <= buffers->channels && length <= buffers->samples)
+        {
+            const juce::SpinLock::ScopedLockType lock(buffers->mutex);
+            if (buffers->top > 0)
+                buffer = buffers->free[(size_t)--buffers->top];
+        }
+        jassert(buffer != nullptr);
+        if (buffer != nullptr)
+            buffer->audio.setDataToReferTo(buffer->channels.data(), num_channels, length);
+        return buffer;
+    }
+    void release(Buffer *buffer)
+    {
+        auto &buffers = buffer->owner;
+        const juce::SpinLock::ScopedLockType lock(buffers.mutex);
+        buffers.free[(size_t)buffers.top++] = buffer;
+    }
+
+private:
+    ScratchPool() = default;
+    // adds buffers until the set has `count`, the new ones are pushed on the free stack
+    static Buffers *fill(Buffers *buffers, int count)
+    {
+        while ((int)buffers->buffers.size() < count)
+        {
+            buffers->buffers.push_back(std::make_unique<Buffer>(*buffers, buffers->channels, buffers->samples));
+            const juce::SpinLock::ScopedLockType lock(buffers->mutex);
+            buffers->free[(size_t)buffers->top++] = buffers->buffers.back().get();
+        }
+        return buffers;
+    }
+
+    std::atomic<Buffers *> current{nullptr};
+};
+
+// a pooled buffer for the current scope
+class ScratchBuffer
+{
+public:
+    ScratchBuffer(int channels, int samples)
+    {
+        pooled = ScratchPool::getInstance().acquire(channels, samples);
+    }
+    ~ScratchBuffer()
+    {
+        if (pooled != nullptr)
+            ScratchPool::getInstance().release(pooled);
+    }
+    ScratchBuffer(const ScratchBuffer &) = delete;
+    ScratchBuffer &operator=(const ScratchBuffer &) = delete;
+    // false when the pool had no buffer left
+    bool isValid()
+    {
+        return pooled != nullptr;
+    }
+    juce::AudioBuffer<float> &get()
+    {
+        return pooled->audio;
+    }
+
+private:
+    ScratchPool::Buffer *pooled;
+};
@@ -0,0 +1,157 @@
+#pragma once
+#include <JuceHeader.h>
+#include <set>
+#include <map>
+
+// Uncompressed copies of long compressed files, kept on disk between sessions. A compressed
+// stream can only be positioned by decoding towards the position, an uncompressed copy is
+// memory mapped and positioned anywhere at no cost. Copies are written in the background
+// the first time a file is streamed and used from the next time it is opened. They take
+// several times the disk space of the files, so the cache is off until it is enabled.
+class SidecarCache
+{
+public:
+    static SidecarCache &getInstance()
+    {
+        static SidecarCache instance;
+        return instance;
+    }
+    ~SidecarCache()
+    {
+        quitting = true;
+        pool.removeAllJobs(true, -1);
+    }
+    // the copy of the file, a file that doesn't exist when there is none yet or the
+    // cache is off
+    juce::File find(const juce::File &source)
+    {
+        if (!enabled)
+            return {};
+        return sidecarFor(source);
+    }
+    // writes the copy in the background unless it exists or is being written
+    void request(const juce::File &source)
+    {
+        if (!enabled)
+            return;
+        auto sidecar = sidecarFor(source);
+        if (sidecar.existsAsFile())
+            return;
+        {
+            const juce::ScopedLock lock(mutex);
+            if (!writing.insert(sidecar.getFullPathName().toStdString()).second)
+                return;
+        }
+        pool.addJob([this, source, sidecar]()
+                    {
+                        write(source, sidecar);
+                        const juce::ScopedLock lock(mutex);
+                        writing.erase(sidecar.getFullPathName().toStdString()); });
+    }
+    // a copy that is played from is never trimmed, until it is released as often as acquired
+    void acquire(const juce::File &sidecar)
+    {
+        const juce::ScopedLock lock(mutex);
+        in_use[sidecar.getFullPathName().toStdString()]++;
+        // the copies played longest ago are trimmed first
+        sidecar.setLastAccessTime(juce::Time::getCurrentTime());
+    }
+    void release(const juce::File &sidecar)
+    {
+        const juce::ScopedLock lock(mutex);
+        auto it = in_use.find(sidecar.getFullPathName().toStdString());
+        if (it != in_use.end() && --it->second == 0)
+            in_use.erase(it);
+    }
+    void setEnabled(bool e)
+    {
+        enabled = e;
+    }
+    bool isEnabled()
+    {
+        return enabled;
+    }
+    void setBudget(juce::int64 bytes)
+    {
+        budget = bytes;
+    }
+
+private:
+    SidecarCache()
+    {
+        formatManager.registerBasicFormats();
+        directory = juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory).getChildFile("Nound").getChildFile("sidecars");
+    }
+    // named after the path, size and modification time, a changed file gets a new copy
+    juce::File sidecarFor(const juce::File &source)
+    {
+        auto id = source.getFullPathName() + "|" + juce::String(source.getSize()) + "|" + juce::String(source.getLastModificationTime().toMilliseconds());
+        return directory.getChildFile(juce::String::toHexString(id.hashCode64()) + ".wav");
+    }
+    void write(const juce::File &source, const juce::File &sidecar)
+    {
+        std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(source));
+        if (reader == nullptr || !directory.createDirectory().wasOk())
+            return;
+        // written under another name and renamed at the end, so a copy that exists is complete
+        auto temp = sidecar.withFileExtension("tmp");
+        temp.deleteFile();
+        std::unique_ptr<juce::AudioFormatWriter> writer;
+        {
+            auto stream = new juce::FileOutputStream(temp);
+            juce::WavAudioFormat wav;
+            writer.reset(wav.createWriterFor(stream, reader->sampleRate, reader->numChannels,
+                                             reader->bitsPerSample > 16 ? 24 : 16, {}, 0));
+            if (writer == nullptr)
+            {
+                delete stream;
+                return;
+            }
+        }
+        // in parts, so quitting the app doesn't wait for a whole long file
+        bool ok = true;
+        for (juce::int64 position = 0; ok && position < reader->lengthInSamples; position += part)
+        {
+            ok = !quitting && writer->writeFromAudioReader(*reader, position, juce::jmin<juce::int64>(part, reader->lengthInSamples - position));
+        }
+        writer.reset();
+        if (!ok || !temp.moveFileTo(sidecar))
+        {
+            temp.deleteFile();
+            return;
+        }
+        trim();
+    }
+    // deletes the copies used longest ago while all of them together exceed the budget,
+    // under the lock so a copy can't be acquired between the check and the delete
+    void trim()
+    {
+        const juce::ScopedLock lock(mutex);
+        auto copies = directory.findChildFiles(juce::File::findFiles, false, "*.wav");
+        std::sort(copies.begin(), copies.end(), [](const juce::File &a, const juce::File &b)
+                  { return a.getLastAccessTime() > b.getLastAccessTime(); });
+        juce::int64 total = 0;
+        for (auto &c : copies)
+        {
+            total += c.getSize();
+            if (total > budget && in_use.count(c.getFullPathName().toStdString()) == 0)
+            {
+                total -= c.getSize();
+                c.deleteFile();
+            }
+        }
+    }
+
+    juce::AudioFormatManager formatManager;
+    juce::File directory;
+    // written one at a time, the disk is the limit
+    juce::ThreadPool pool{1};
+    juce::CriticalSection mutex;
+    std::set<std::string> writing;
+    // how many sources play from each copy
+    std::map<std::string, int> in_use;
+    std::atomic<bool> enabled{false};
+    std::atomic<bool> quitting{false};
+    static constexpr int part = 1 << 18;
+    std::atomic<juce::int64> budget{(juce::int64)16 * 1024 * 1024 * 1024};
+};
@@ -1,6 +1,12 @@
 #pragma once
 #include <JuceHeader.h>
 #include "Functions.h"
+#include "RenderPool.h"
+#include "ScratchPool.h"
+#include "ClipCache.h"
+#include "ReadAheadSource.h"
+#include "SidecarCache.h"
+#include "Arena.h"
 
 class PositionableSource : public juce::AudioSource
 {
@@ -21,25 +27,141 @@ public:
     {
         return getCurrentPosition() < getLength();
     }
+    // a source is prepared once until the next restart(), so preparing a tree that shares
+    // sources with the playing one only reaches its new sources
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) final
+    {
+        if (prepared_in == generation())
+            return;
+        prepared_in = generation();
+        prepare(samplesPerBlockExpected, sampleRate);
+    }
+    // the next prepareToPlay reaches every source again, called before the device starts
+    static void restart()
+    {
+        generation()++;
+    }
+
+protected:
+    virtual void prepare(int samplesPerBlockExpected, double sampleRate) = 0;
+
+private:
+    static int &generation()
+    {
+        static int current = 1;
+        return current;
+    }
+    int prepared_in = 0;
 };
 
-class Player : private juce::AudioSource
+// Deferred deletion of objects that the audio thread may still be reading.
+// Objects retired on the message thread are deleted after a new graph was
+// published and the audio callback has finished at least once since then.
+class Reclaimer
+{
+public:
+    static Reclaimer &getInstance()
+    {
+        static Reclaimer instance;
+        return instance;
+    }
+    ~Reclaimer()
+    {
+        collect(true);
+    }
+    template <class T>
+    void retire(T *object)
+    {
+        if (object == nullptr)
+            return;
+        retired.push_back({pending, [object]()
+                           { delete object; }});
+    }
+    // called by the audio thread at the end of every callback
+    void audioCallbackFinished()
+    {
+        epoch.fetch_add(1, std::memory_order_release);
+    }
+    // called after the audio thread was switched to a new graph
+    void published()
+    {
+        auto current = epoch.load(std::memory_order_acquire);
+        for (auto &r : retired)
+        {
+            if (r.epoch == pending)
+                r.epoch = current;
+        }
+    }
+    // deletes everything when the audio device is not running
+    void collect(bool all)
+    {
+        auto current = epoch.load(std::memory_order_acquire);
+        auto end = std::partition(retired.begin(), retired.end(), [&](const Retired &r)
+                                  { return !all && (r.epoch == pending || r.epoch >= current); });
+        std::vector<Retired> expired(std::make_move_iterator(end), std::make_move_iterator(retired.end()));
+        retired.erase(end, retired.end());
+        for (auto &r : expired)
+            r.destroy();
+    }
+
+private:
+    // statics are destroyed in the reverse order they were created in. The singletons the
+    // retired objects use in their destructors are created first, so they outlive the
+    // reclaimer and what it deletes when the app quits
+    Reclaimer()
+    {
+        SlabAllocator::getInstance();
+        ReadAheadThreads::getInstance();
+        SidecarCache::getInstance();
+    }
+    struct Retired
+    {
+        uint64_t epoch;
+        std::function<void()> destroy;
+    };
+    static constexpr uint64_t pending = std::numeric_limits<uint64_t>::max();
+    std::atomic<uint64_t> epoch{0};
+    std::vector<Retired> retired;
+};
+
+class Player : private juce::AudioSource, private juce::Timer
 {
 public:
     Player(int _sample_rate, int _samples_per_block)
     {
         source = nullptr;
+        position = 0;
         offset_cof = 0;
         sample_rate = _sample_rate;
         samples_per_block = _samples_per_block;
         playing = false;
+        startTimer(100);
     };
+    ~Player() override
+    {
+        Stop();
+    }
 
-    void setSource(PositionableSource *s)
+    // `scratch_buffers` is the most pooled buffers the tree's sources take at once
+    void setSource(PositionableSource *s, int scratch_buffers)
     {
-        source = s;
+        source.store(s, std::memory_order_release);
+        scratch = scratch_buffers;
     };
 
+    // switches the playing device to a new source without stopping it. Only the sources
+    // the playing tree doesn't share are prepared here, the audio thread positions the new
+    // tree before its first block
+    void publish(PositionableSource *s, int scratch_buffers)
+    {
+        if (s != nullptr)
+            s->prepareToPlay(samples_per_block, sample_rate);
+        scratch = scratch_buffers;
+        Reclaimer::getInstance().retire(ScratchPool::getInstance().reserve(scratch, samples_per_block));
+        source.exchange(s, std::memory_order_acq_rel);
+        Reclaimer::getInstance().published();
+    }
+
     void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override
     {
     }
@@ -55,38 +177,61 @@ public:
 
     void releaseResources() override
     {
-        if (source == nullptr)
+        auto s = source.load(std::memory_order_acquire);
+        if (s == nullptr)
             return;
 
-        source->releaseResources();
+        s->releaseResources();
     }
     void getNextAudioBlock(const juce::AudioSourceChannelInfo &bufferToFill) override
     {
-        if (source == nullptr || source->isPlaying() == false)
+        auto s = source.load(std::memory_order_acquire);
+        // a published tree continues where the last one was. The last one is only deleted
+        // after this callback, so a new tree can't reuse its address before it was seen
+        if (s != current)
+        {
+            current = s;
+            if (s != nullptr)
+                s->setPosition(position.load(std::memory_order_relaxed));
+        }
+        if (s == nullptr || s->isPlaying() == false)
         {
             bufferToFill.clearActiveBufferRegion();
-            //   Stop();
-            return;
         }
-        source->getNextAudioBlock(bufferToFill);
+        else
+        {
+            s->getNextAudioBlock(bufferToFill);
+            position.store(s->getCurrentPosition(), std::memory_order_relaxed);
+        }
+        Reclaimer::getInstance().audioCallbackFinished();
     };
 
     void Start()
     {
-        if (source == nullptr)
+        auto s = source.load(std::memory_order_acquire);
+        if (s == nullptr)
             return;
         playing = true;
-        source->prepareToPlay(samples_per_block, sample_rate);
-        source->setPosition(offset_cof * sample_rate * source->getLengthInSeconds());
+        PositionableSource::restart();
+        s->prepareToPlay(samples_per_block, sample_rate);
+        Reclaimer::getInstance().retire(ScratchPool::getInstance().reserve(scratch, samples_per_block));
+        s->setPosition(offset_cof * sample_rate * s->getLengthInSeconds());
+        position = s->getCurrentPosition();
+        // the device isn't running yet
+        current = s;
         setAudioChannels(0, 2);
     }
     void resume()
     {
-        if (source == nullptr)
+        if (source.load() == nullptr)
             return;
         playing = true;
         setAudioChannels(0, 2);
     }
+    bool isPlaying()
+    {
+        return playing;
+    }
     void setPosition(float coefficient)
     {
         offset_cof = coefficient;
@@ -113,29 +258,42 @@ public:
         deviceManager.closeAudioDevice();
         deviceManager.removeAudioCallback(&audioSourcePlayer);
         // }
+        Reclaimer::getInstance().collect(true);
     }
 
     int getLength()
     {
-        if (source == nullptr)
+        auto s = source.load();
+        if (s == nullptr)
             return 0;
-        return source->getLength();
+        return s->getLength();
     }
     float getLengthInSeconds()
     {
-        if (source == nullptr)
+        auto s = source.load();
+        if (s == nullptr)
             return 0;
-        return source->getLengthInSeconds();
+        return s->getLengthInSeconds();
     }
     void setPositionInSeconds(float offset, double sampleRate)
     {
-        if (source == nullptr)
+        auto s = source.load();
+        if (s == nullptr)
             return;
-        source->setPositionInSeconds(offset, sampleRate);
+        s->setPositionInSeconds(offset, sampleRate);
     }
 
 private:
-    PositionableSource *source;
+    void timerCallback() override
+    {
+        Reclaimer::getInstance().collect(!playing);
+    }
+
+    std::atomic<PositionableSource *> source;
+    // the source the audio thread played last
+    PositionableSource *current = nullptr;
+    int scratch = 0;
+    std::atomic<int> position;
     juce::AudioDeviceManager deviceManager;
     juce::AudioSourcePlayer audioSourcePlayer;
     float offset_cof;
@@ -144,20 +302,269 @@ private:
     bool playing;
 };
 
+// Renders one source once per block for several consumers. Each consumer reads
+// through its own Reader. At the start of every block, before the consumers run, the
+// tee renders what its readers are about to read: the samples that follow what they read
+// in the last block, or where they were positioned. It keeps the last few blocks, so
+// readers at slightly different positions share them and only copy. A reader that asks
+// for samples outside of them renders them itself.
+class TeeSource
+{
+public:
+    class Reader : public PositionableSource
+    {
+    public:
+        Reader(TeeSource &_tee) : tee(_tee), position(0){};
+        void prepare(int samplesPerBlockExpected, double sampleRate) override
+        {
+            tee.prepare(samplesPerBlockExpected, sampleRate);
+        }
+        void releaseResources() override
+        {
+            tee.release();
+        }
+        void getNextAudioBlock(const juce::AudioSourceChannelInfo &bufferToFill) override
+        {
+            tee.read(*this, bufferToFill);
+            position += bufferToFill.numSamples;
+        }
+        void setPosition(int p = 0) override
+        {
+            position = p;
+            active = true;
+        }
+        int getCurrentPosition() override
+        {
+            return position;
+        }
+        int getLength() override
+        {
+            return tee.source->getLength();
+        }
+        float getLengthInSeconds() override
+        {
+            return tee.source->getLengthInSeconds();
+        }
+
+    private:
+        friend class TeeSource;
+        TeeSource &tee;
+        int position;
+        // read in the last block or positioned since, the next block is rendered for it
+        bool active = false;
+    };
+
+    TeeSource()
+    {
+        source = nullptr;
+        prepared = false;
+    }
+    // called once, before the readers are prepared
+    void setSource(PositionableSource *s)
+    {
+        source = s;
+        prepared = false;
+        cached_start = cached_end = 0;
+        source_position = -1;
+    }
+    void setReaders(int count)
+    {
+        while ((int)readers.size() > count)
+        {
+            Reclaimer::getInstance().retire(readers.back().release());
+            readers.pop_back();
+        }
+        while ((int)readers.size() < count)
+            readers.push_back(std::make_unique<Reader>(*this));
+    }
+    PositionableSource *getReader(int i)
+    {
+        return readers[i].get();
+    }
+    // called on the audio thread before the consumers render a block of n samples, after the
+    // tees upstream of this one. Nothing reads the tee meanwhile
+    void renderBlock(int n)
+    {
+        if (!prepared)
+            return;
+        int from = std::numeric_limits<int>::max();
+        int to = std::numeric_limits<int>::min();
+        for (auto &r : readers)
+        {
+            if (!r->active)
+                continue;
+            r->active = false;
+            from = juce::jmin(from, r->position);
+            to = juce::jmax(to, r->position + n);
+        }
+        if (from > to)
+            return;
+        // readers further apart than the kept blocks render the rest themselves
+        to = juce::jmin(to, from + cache.getNumSamples());
+        // readers that don't continue the kept blocks start over from their position
+        if (from < cached_start || from > cached_end)
+            cached_start = cached_end = from;
+        while (cached_end < to)
+            renderNext(juce::jmin(to - cached_end, block.getNumSamples()));
+    }
+
+private:
+    // the device plays stereo, further channels of a reader's buffer are silent
+    static constexpr int channels = 2;
+    static constexpr int blocks_kept = 4;
+
+    void prepare(int samplesPerBlockExpected, double sampleRate)
+    {
+        if (prepared)
+            return;
+        source->prepareToPlay(samplesPerBlockExpected, sampleRate);
+        block.setSize(channels, samplesPerBlockExpected);
+        cache.setSize(channels, samplesPerBlockExpected * blocks_kept);
+        cached_start = cached_end = 0;
+        source_position = -1;
+        prepared = true;
+    }
+    void release()
+    {
+        if (!prepared)
+            return;
+        source->releaseResources();
+        prepared = false;
+    }
+    // the kept blocks don't change while the consumers run, so readers copy without a lock
+    void read(Reader &reader, const juce::AudioSourceChannelInfo &bufferToFill)
+    {
+        int position = reader.position;
+        int n = bufferToFill.numSamples;
+        reader.active = true;
+        if (position < cached_start || position + n > cached_end)
+        {
+            renderDirectly(position, bufferToFill);
+            return;
+        }
+        auto output = bufferToFill.buffer;
+        for (int channel = 0; channel < output->getNumChannels(); channel++)
+        {
+            auto to = output->getWritePointer(channel, bufferToFill.startSample);
+            if (channel < channels)
+                copyFromCache(channel, position, to, n);
+            else
+                juce::FloatVectorOperations::clear(to, n);
+        }
+    }
+    // renders the next m samples after the kept ones
+    void renderNext(int m)
+    {
+        int from = cached_end;
+        if (source_position != from)
+            source->setPosition(from);
+        source->getNextAudioBlock(juce::AudioSourceChannelInfo(&block, 0, m));
+        // the oldest samples make room
+        cached_start = juce::jmax(cached_start, from + m - cache.getNumSamples());
+        for (int channel = 0; channel < channels; channel++)
+            copyToCache(channel, from, block.getReadPointer(channel), m);
+        cached_end = source_position = from + m;
+    }
+    // samples that weren't rendered for the block, after a seek or for a reader that started
+    // over. Readers that miss at the same time take turns, the kept blocks stay as they are
+    void renderDirectly(int position, const juce::AudioSourceChannelInfo &bufferToFill)
+    {
+        const juce::SpinLock::ScopedLockType lock(mutex);
+        if (source_position != position)
+            source->setPosition(position);
+        source->getNextAudioBlock(bufferToFill);
+        source_position = position + bufferToFill.numSamples;
+    }
+    // the cache is a ring, sample p is at index p % size
+    void copyFromCache(int channel, int from, float *to, int n)
+    {
+        int size = cache.getNumSamples();
+        int index = from % size;
+        int first = juce::jmin(n, size - index);
+        juce::FloatVectorOperations::copy(to, cache.getReadPointer(channel, index), first);
+        juce::FloatVectorOperations::copy(to + first, cache.getReadPointer(channel), n - first);
+    }
+    void copyToCache(int channel, int to, const float *from, int n)
+    {
+        int size = cache.getNumSamples();
+        int index = to % size;
+        int first = juce::jmin(n, size - index);
+        juce::FloatVectorOperations::copy(cache.getWritePointer(channel, index), from, first);
+        juce::FloatVectorOperations::copy(cache.getWritePointer(channel), from + first, n - first);
+    }
+
+    PositionableSource *source;
+    std::vector<std::unique_ptr<Reader>> readers;
+    // held by readers that render directly
+    juce::SpinLock mutex;
+    bool prepared;
+    // sized in prepare, the block the source renders into and the blocks kept
+    juce::AudioBuffer<float> block;
+    juce::AudioBuffer<float> cache;
+    int cached_start = 0;
+    int cached_end = 0;
+    // where the source continues, -1 when it has to be positioned first
+    int source_position = -1;
+};
+
+// The root of a published tree. At the start of every block it renders the tees of the
+// tree, upstream ones first, so their consumers only copy
+class ScheduledSource : public PositionableSource
+{
+public:
+    // `tees` in the order of the graph, every tee after the tees its source reads
+    ScheduledSource(PositionableSource *_root, std::vector<TeeSource *> _tees) : root(_root), tees(std::move(_tees)){};
+    void prepare(int samplesPerBlockExpected, double sampleRate) override
+    {
+        root->prepareToPlay(samplesPerBlockExpected, sampleRate);
+    }
+    void releaseResources() override
+    {
+        root->releaseResources();
+    }
+    void getNextAudioBlock(const juce::AudioSourceChannelInfo &bufferToFill) override
+    {
+        for (auto tee : tees)
+            tee->renderBlock(bufferToFill.numSamples);
+        root->getNextAudioBlock(bufferToFill);
+    }
+    void setPosition(int p) override
+    {
+        root->setPosition(p);
+    }
+    int getCurrentPosition() override
+    {
+        return root->getCurrentPosition();
+    }
+    int getLength() override
+    {
+        return root->getLength();
+    }
+    float getLengthInSeconds() override
+    {
+        return root->getLengthInSeconds();
+    }
+
+private:
+    PositionableSource *root;
+    std::vector<TeeSource *> tees;
+};
+
 class ReverbSource : public PositionableSource
 {
 public:
     ReverbSource()
     {
         source = nullptr;
-        r = nullptr;
     }
     void setSource(PositionableSource *s)
     {
+        if (s == source && r != nullptr)
+            return;
         source = s;
-        r = new juce::ReverbAudioSource(s, false);
+        r.reset(new juce::ReverbAudioSource(s, false));
     }
-    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override
+    void prepare(int samplesPerBlockExpected, double sampleRate) override
     {
         r->prepareToPlay(samplesPerBlockExpected, sampleRate);
     }
@@ -186,9 +593,14 @@ public:
         return source->getLengthInSeconds();
     }
     PositionableSource *source;
-    juce::ReverbAudioSource *r;
+    std::unique_ptr<juce::ReverbAudioSource> r;
 };
 
+// Uncompressed WAV and AIFF files are memory mapped and read on the audio thread straight
+// from the page cache, so a seek is only a new read position. Other formats are decoded
+// whole into the ClipCache and shared with every source of the same file, files too
+// large for the cache are streamed through a ReadAheadSource until the SidecarCache has
+// an uncompressed copy of them, which is then mapped like a WAV file.
 class FileSource : public PositionableSource
 {
 public:
@@ -197,46 +609,171 @@ public:
     }
     bool setFile(std::string filepath)
     {
+        // removes the previous stream from its reading thread
         transportSource.stop();
-        thread.stopThread(-1);
+        transportSource.setSource(nullptr, 0, nullptr, 0);
+        read_ahead.reset();
+        closeMapped();
+        clip.reset();
+        decoding.reset();
+        cached = false;
 
+        loaded = false;
         path = filepath;
         file = juce::File(filepath);
+        if (openMapped(file))
+        {
+            setPosition(0);
+            loaded = true;
+            return true;
+        }
         juce::AudioFormatManager formatManager;
         formatManager.registerBasicFormats();
         juce::AudioFormatReader *reader = formatManager.createReaderFor(file);
         if (reader == nullptr)
             return false;
-        thread.startThread();
-        juce::AudioFormatReaderSource *readerSource = new juce::AudioFormatReaderSource(reader, true);
-        //   thread.startThread(juce::Thread::Priority::normal);
-        if (readerSource->getAudioFormatReader() != false)
-        {
-            transportSource.setSource(readerSource,
-                                      32768, &thread,
-                                      readerSource->getAudioFormatReader()->sampleRate);
+        if (ClipCache::getInstance().fits(reader->lengthInSamples, juce::jlimit(1, 2, (int)reader->numChannels)))
+        {
+            // taken from the cache once the playback rate is known, streamed while it is decoded
+            cached = true;
+            file_length = reader->lengthInSamples;
+            file_sample_rate = reader->sampleRate;
+            stream_reader.reset(reader);
             setPosition(0);
+            loaded = true;
             return true;
         }
-        else
+        if (openSidecar())
         {
-            return false;
+            delete reader;
+            setPosition(0);
+            loaded = true;
+            return true;
         }
+        SidecarCache::getInstance().request(file);
+        openStream(reader);
+        setPosition(0);
+        loaded = true;
+        return true;
     }
-    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override
+    // decodes a file that will be played from the ClipCache ahead of its first build,
+    // files that are mapped or streamed need no preparation
+    static void prefetch(const juce::File &f, double sampleRate)
+    {
+        if (createMapped(f) != nullptr)
+            return;
+        juce::AudioFormatManager formatManager;
+        formatManager.registerBasicFormats();
+        std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(f));
+        if (reader == nullptr || !ClipCache::getInstance().fits(reader->lengthInSamples, juce::jlimit(1, 2, (int)reader->numChannels)))
+            return;
+        reader.reset();
+        try
+        {
+            ClipCache::getInstance().get(f, sampleRate);
+        }
+        catch (...)
+        {
+            // decoded again, or streamed, when the file is played
+        }
+    }
+    // a streamed file is opened again once its uncompressed copy was written, a file streamed
+    // while it was decoded once the clip is there
+    bool isOutdated()
+    {
+        if (cached)
+            return decoding != nullptr && decoding->ready.load(std::memory_order_acquire) && decoding->clip != nullptr;
+        return read_ahead != nullptr && SidecarCache::getInstance().find(file).existsAsFile();
+    }
+    // nullptr unless the file is streamed
+    ReadAheadSource *getReadAhead()
+    {
+        return read_ahead.get();
+    }
+    bool isMapped()
+    {
+        return mapped != nullptr;
+    }
+    void prepare(int samplesPerBlockExpected, double sampleRate) override
     {
-        transportSource.prepareToPlay(samplesPerBlockExpected, sampleRate);
         sample_rate = sampleRate;
+        if (isMapped())
+        {
+            // the ratio is 1 when the file is at the device rate, then the resampler is skipped
+            ratio = mapped->sampleRate / sampleRate;
+            resampler->setResamplingRatio(ratio);
+            resampler->prepareToPlay(samplesPerBlockExpected, sampleRate);
+            return;
+        }
+        if (cached && (clip == nullptr || clip->sample_rate != sampleRate) && (decoding == nullptr || decoding->sample_rate != sampleRate))
+        {
+            decoding.reset();
+            clip = ClipCache::getInstance().find(file, sampleRate);
+            if (clip != nullptr)
+            {
+                // the stream isn't needed
+                stream_reader.reset();
+                return;
+            }
+            // never decoded on this thread, the file is streamed until the clip is ready
+            auto slot = std::make_shared<DecodedClip>();
+            slot->sample_rate = sampleRate;
+            decoding = slot;
+            ClipCache::getInstance().decodeAsync(file, sampleRate, [slot](std::shared_ptr<const ClipCache::Clip> c)
+                                                 {
+                                                     slot->clip = std::move(c);
+                                                     slot->ready.store(true, std::memory_order_release); });
+            if (read_ahead == nullptr)
+            {
+                if (stream_reader == nullptr)
+                {
+                    juce::AudioFormatManager formatManager;
+                    formatManager.registerBasicFormats();
+                    stream_reader.reset(formatManager.createReaderFor(file));
+                }
+                if (stream_reader != nullptr)
+                    openStream(stream_reader.release());
+            }
+        }
+        if (cached && read_ahead == nullptr)
+            return;
+        transportSource.prepareToPlay(samplesPerBlockExpected, sampleRate);
         transportSource.start();
-
-        // thread.startThread();
     }
     void releaseResources() override
     {
+        if (isMapped())
+        {
+            resampler->releaseResources();
+            return;
+        }
+        if (cached && read_ahead == nullptr)
+            return;
         transportSource.releaseResources();
     }
     void getNextAudioBlock(const juce::AudioSourceChannelInfo &bufferToFill) override
     {
+        if (isMapped())
+        {
+            // at the device rate the samples are converted straight from the mapping into
+            // the block, past the end it reads zeros
+            if (ratio == 1.0)
+                mapped->read(bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples, position, true, true);
+            else
+                resampler->getNextAudioBlock(bufferToFill);
+            position += bufferToFill.numSamples;
+            return;
+        }
+        if (cached)
+        {
+            auto playing = playingClip();
+            if (playing != nullptr || read_ahead == nullptr)
+                readClip(playing, bufferToFill);
+            else
+                transportSource.getNextAudioBlock(bufferToFill);
+            position += bufferToFill.numSamples;
+            return;
+        }
         //  if (transportSource.isPlaying())
         //   {
         transportSource.getNextAudioBlock(bufferToFill);
@@ -249,32 +786,166 @@ public:
     };
     void setPosition(int p) override
     {
+        if (isMapped())
+        {
+            position = p;
+            reader_source->setNextReadPosition((juce::int64)(p * ratio));
+            resampler->flushBuffers();
+            return;
+        }
+        if (cached)
+        {
+            position = p;
+            if (read_ahead == nullptr || sample_rate <= 0)
+                return;
+        }
         transportSource.setPosition(p / (double)sample_rate);
         transportSource.start();
     }
     int getCurrentPosition() override
     {
+        if (isMapped() || cached)
+            return position;
         return (double)transportSource.getCurrentPosition() * (double)sample_rate;
     }
     int getLength() override
     {
+        if (isMapped())
+            return mapped->lengthInSamples / ratio;
+        if (cached)
+        {
+            if (clip != nullptr)
+                return clip->getNumSamples();
+            // the length the clip will have at the playback rate
+            return sample_rate > 0 ? (int)(file_length * sample_rate / file_sample_rate) : file_length;
+        }
         return transportSource.getTotalLength();
     }
     float getLengthInSeconds() override
     {
+        if (isMapped())
+            return mapped->lengthInSamples / mapped->sampleRate;
+        if (cached)
+            return file_length / file_sample_rate;
         return transportSource.getLengthInSeconds();
     }
     ~FileSource() override
     {
         transportSource.stop();
-        thread.stopThread(-1);
         transportSource.setSource(nullptr, 0, nullptr, 0);
+        read_ahead.reset();
+        closeMapped();
     }
     std::string path;
+    bool loaded = false;
     juce::AudioTransportSource transportSource;
     juce::File file;
-    double sample_rate;
-    juce::TimeSliceThread thread{"audio file reading thread"};
+    double sample_rate = 0;
+
+private:
+    // written once by the decoding thread, read by the audio thread once ready is set
+    struct DecodedClip
+    {
+        double sample_rate = 0;
+        std::shared_ptr<const ClipCache::Clip> clip;
+        std::atomic<bool> ready{false};
+    };
+
+    std::unique_ptr<ReadAheadSource> read_ahead;
+    // nullptr unless the file is an uncompressed format that could be mapped whole
+    std::unique_ptr<juce::MemoryMappedAudioFormatReader> mapped;
+    std::unique_ptr<juce::AudioFormatReaderSource> reader_source;
+    std::unique_ptr<juce::ResamplingAudioSource> resampler;
+    juce::int64 position = 0;
+    double ratio = 1.0;
+    // the decoded file, shared through the ClipCache
+    bool cached = false;
+    std::shared_ptr<const ClipCache::Clip> clip;
+    // shared with the decoding job, which may finish after the source is gone
+    std::shared_ptr<DecodedClip> decoding;
+    // kept from setFile until it is known whether the file has to be streamed
+    std::unique_ptr<juce::AudioFormatReader> stream_reader;
+    juce::int64 file_length = 0;
+    double file_sample_rate = 0;
+    // the uncompressed copy that is mapped, kept from being trimmed while it is
+    juce::File sidecar;
+
+    // streamed, read ahead as far as this file needs, the transport only converts the rate
+    void openStream(juce::AudioFormatReader *reader)
+    {
+        double file_rate = reader->sampleRate;
+        read_ahead.reset(new ReadAheadSource(new juce::AudioFormatReaderSource(reader, true), (int)reader->numChannels));
+        transportSource.setSource(read_ahead.get(), 0, nullptr, file_rate);
+    }
+    // the clip that was there when the source was prepared, or the one decoded since
+    const ClipCache::Clip *playingClip()
+    {
+        if (clip != nullptr)
+            return clip.get();
+        if (decoding != nullptr && decoding->ready.load(std::memory_order_acquire))
+            return decoding->clip.get();
+        return nullptr;
+    }
+    void readClip(const ClipCache::Clip *playing, const juce::AudioSourceChannelInfo &bufferToFill)
+    {
+        int available = playing != nullptr ? (int)juce::jlimit<juce::int64>(0, bufferToFill.numSamples, playing->getNumSamples() - position) : 0;
+        for (int channel = 0; channel < bufferToFill.buffer->getNumChannels(); ++channel)
+        {
+            auto output = bufferToFill.buffer->getWritePointer(channel, bufferToFill.startSample);
+            // a mono clip plays on every channel
+            if (available > 0)
+                playing->read(channel % playing->getNumChannels(), (int)position, output, available);
+            juce::FloatVectorOperations::clear(output + available, bufferToFill.numSamples - available);
+        }
+    }
+
+    static std::unique_ptr<juce::MemoryMappedAudioFormatReader> createMapped(const juce::File &file)
+    {
+        juce::WavAudioFormat wav;
+        juce::AiffAudioFormat aiff;
+        std::unique_ptr<juce::MemoryMappedAudioFormatReader> reader;
+        if (wav.canHandleFile(file))
+            reader.reset(wav.createMemoryMappedReader(file));
+        else if (aiff.canHandleFile(file))
+            reader.reset(aiff.createMemoryMappedReader(file));
+        return reader;
+    }
+    bool openMapped(const juce::File &f)
+    {
+        auto reader = createMapped(f);
+        if (reader == nullptr || reader->lengthInSamples <= 0 || !reader->mapEntireFile())
+            return false;
+        mapped = std::move(reader);
+        // only used when the file has to be resampled to the device rate
+        reader_source.reset(new juce::AudioFormatReaderSource(mapped.get(), false));
+        resampler.reset(new juce::ResamplingAudioSource(reader_source.get(), false, juce::jmax(2, (int)mapped->numChannels)));
+        ratio = 1.0;
+        return true;
+    }
+    // pinned before it is mapped, so the cache can't delete it in between
+    bool openSidecar()
+    {
+        auto copy = SidecarCache::getInstance().find(file);
+        if (!copy.existsAsFile())
+            return false;
+        SidecarCache::getInstance().acquire(copy);
+        if (!openMapped(copy))
+        {
+            SidecarCache::getInstance().release(copy);
+            return false;
+        }
+        sidecar = copy;
+        return true;
+    }
+    void closeMapped()
+    {
+        resampler.reset();
+        reader_source.reset();
+        mapped.reset();
+        if (sidecar != juce::File())
+            SidecarCache::getInstance().release(sidecar);
+        sidecar = juce::File();
+    }
 };
 
 class Osc : public PositionableSource
@@ -289,7 +960,7 @@ public:
         waveform = w;
     }
 
-    void prepareToPlay(int samplesPerBlockExpected, double _sampleRate) override
+    void prepare(int samplesPerBlockExpected, double _sampleRate) override
     {
         sampleRate = _sampleRate;
         period = 1.0f / sampleRate;
@@ -298,21 +969,32 @@ public:
     void releaseResources() override
     {
     }
+    // flattens the current waveform tree, called on every build before the source is published
+    void compile()
+    {
+        program.compile(*waveform);
+    }
 
     void getNextAudioBlock(const juce::AudioSourceChannelInfo &bufferToFill) override
     {
-        for (auto sample = 0; sample < bufferToFill.numSamples; ++sample)
+        auto *first = bufferToFill.buffer->getWritePointer(0, bufferToFill.startSample);
+        double x[F::max_block];
+        double out[F::max_block];
+        double step = 2.0f * juce::MathConstants<double>::pi * frequency * period;
+        // the position stops at the end, like the per sample version did
+        int last = std::max(n, samples_count);
+        for (int start = 0; start < bufferToFill.numSamples; start += F::max_block)
         {
-            auto radians = 2.0f * juce::MathConstants<double>::pi * frequency * period * n + phase;
-            auto currentSample = (*waveform)->get(radians);
-            for (auto channel = 0; channel < bufferToFill.buffer->getNumChannels(); ++channel)
-            {
-                auto *buffer = bufferToFill.buffer->getWritePointer(channel, bufferToFill.startSample);
-                buffer[sample] = currentSample;
-            }
-            if (isPlaying())
-                n++;
+            int count = std::min(F::max_block, bufferToFill.numSamples - start);
+            for (int i = 0; i < count; i++)
+                x[i] = step * std::min(n + i, last) + phase;
+            program.run(x, out, count);
+            for (int i = 0; i < count; i++)
+                first[start + i] = (float)out[i];
+            n = std::min(n + count, last);
         }
+        for (auto channel = 1; channel < bufferToFill.buffer->getNumChannels(); ++channel)
+            bufferToFill.buffer->copyFrom(channel, bufferToFill.startSample, *bufferToFill.buffer, 0, bufferToFill.startSample, bufferToFill.numSamples);
     }
     void setPosition(int p) override
     {
@@ -340,6 +1022,7 @@ private:
     float time;
     int samples_count;
     F **waveform;
+    FunctionProgram program;
 };
 
 class MathAudioSource : public PositionableSource
@@ -386,15 +1069,25 @@ public:
         }
     };
 
+    // ids of the selector in AudioMathNode
+    enum Operation
+    {
+        add = 1,
+        substract,
+        multiply,
+        divide
+    };
+
     MathAudioSource()
     {
         s1 = nullptr;
         s2 = nullptr;
+        operation = nullptr;
     }
     ~MathAudioSource()
     {
     }
-    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override
+    void prepare(int samplesPerBlockExpected, double sampleRate) override
     {
         if (s2 != nullptr)
             s2->prepareToPlay(samplesPerBlockExpected, sampleRate);
@@ -410,22 +1103,55 @@ public:
     }
     void getNextAudioBlock(const juce::AudioSourceChannelInfo &bufferToFill) override
     {
-        temp1.setSize(juce::jmax(1, bufferToFill.buffer->getNumChannels()),
-                      bufferToFill.buffer->getNumSamples());
-        temp2.setSize(juce::jmax(1, bufferToFill.buffer->getNumChannels()),
-                      bufferToFill.buffer->getNumSamples());
+        int channels = juce::jmax(1, bufferToFill.buffer->getNumChannels());
+        // both scratch buffers go back to the pool once they are mixed into the output
+        ScratchBuffer scratch1(channels, bufferToFill.numSamples);
+        ScratchBuffer scratch2(channels, bufferToFill.numSamples);
+        if (!scratch1.isValid() || !scratch2.isValid())
+        {
+            bufferToFill.clearActiveBufferRegion();
+            return;
+        }
+        auto &temp1 = scratch1.get();
+        auto &temp2 = scratch2.get();
+        // the two inputs are separate source trees, so they can be rendered at the same time
+        RenderPool::Job jobs[2];
+        int count = 0;
         if (s1 != nullptr)
-            s1->getNextAudioBlock(juce::AudioSourceChannelInfo(&temp1, 0, bufferToFill.numSamples));
+            jobs[count++] = {s1, juce::AudioSourceChannelInfo(&temp1, 0, bufferToFill.numSamples)};
         if (s2 != nullptr)
-            s2->getNextAudioBlock(juce::AudioSourceChannelInfo(&temp2, 0, bufferToFill.numSamples));
+            jobs[count++] = {s2, juce::AudioSourceChannelInfo(&temp2, 0, bufferToFill.numSamples)};
+        RenderPool::getInstance().render(jobs, count);
+        // read once, so a change from the editor applies from the next block on
+        int op = operation != nullptr ? operation->load(std::memory_order_relaxed) : add;
         for (auto channel = 0; channel < bufferToFill.buffer->getNumChannels(); ++channel)
         {
-            auto buffer1 = temp1.getReadPointer(channel, bufferToFill.startSample);
-            auto buffer2 = temp2.getReadPointer(channel, bufferToFill.startSample);
-
+            auto buffer1 = temp1.getReadPointer(channel);
+            auto buffer2 = temp2.getReadPointer(channel);
             auto buffer = bufferToFill.buffer->getWritePointer(channel, bufferToFill.startSample);
-            for (auto sample = 0; sample < bufferToFill.numSamples; ++sample)
-                buffer[sample] = state->get()->operation(buffer1[sample], buffer2[sample]);
+            combine(op, buffer, buffer1, buffer2, bufferToFill.numSamples);
+        }
+    }
+    static void combine(int op, float *dest, const float *a, const float *b, int n)
+    {
+        switch (op)
+        {
+        case add:
+            juce::FloatVectorOperations::add(dest, a, b, n);
+            break;
+        case substract:
+            juce::FloatVectorOperations::subtract(dest, a, b, n);
+            break;
+        case multiply:
+            juce::FloatVectorOperations::multiply(dest, a, b, n);
+            break;
+        case divide:
+            // silence instead of inf or nan where the divisor is zero
+            for (int i = 0; i < n; i++)
+                dest[i] = b[i] != 0.0f ? a[i] / b[i] : 0.0f;
+            break;
+        default:
+            juce::FloatVectorOperations::clear(dest, n);
         }
     }
     void setPosition(int p) override
@@ -452,9 +1178,132 @@ public:
     }
     PositionableSource *s1;
     PositionableSource *s2;
-    juce::AudioBuffer<float> temp1;
-    juce::AudioBuffer<float> temp2;
-    std::unique_ptr<State> *state;
+    const std::atomic<int> *operation;
+};
+
+// Sums any number of inputs into the output, each with its own gain and pan.
+// Every input is rendered into the same scratch buffer and multiply-added into
+// the output, so the cost is one buffer however many inputs are mixed.
+class MixerSource : public PositionableSource
+{
+public:
+    struct Input
+    {
+        PositionableSource *source;
+        // owned by the node, read once per block
+        const std::atomic<float> *gain;
+        const std::atomic<float> *pan;
+    };
+    MixerSource()
+    {
+        position = 0;
+    }
+    void setInputs(std::vector<Input> i)
+    {
+        inputs = std::move(i);
+    }
+    void prepare(int samplesPerBlockExpected, double sampleRate) override
+    {
+        // every input is rendered into its own pooled buffer, all of them at the same time
+        rendered.resize(inputs.size());
+        jobs.resize(inputs.size());
+        for (auto &i : inputs)
+            i.source->prepareToPlay(samplesPerBlockExpected, sampleRate);
+    }
+    void releaseResources() override
+    {
+        for (auto &i : inputs)
+            i.source->releaseResources();
+    }
+    void getNextAudioBlock(const juce::AudioSourceChannelInfo &bufferToFill) override
+    {
+        int channels = bufferToFill.buffer->getNumChannels();
+        int n = bufferToFill.numSamples;
+        bufferToFill.clearActiveBufferRegion();
+        // the inputs are separate source trees. A muted one is rendered too and its block
+        // dropped, so it stays in time and its effects keep their state
+        int count = 0;
+        for (int k = 0; k < (int)inputs.size(); k++)
+        {
+            if (!inputs[k].source->isPlaying())
+                continue;
+            auto &r = rendered[k];
+            r.pooled = ScratchPool::getInstance().acquire(juce::jmax(1, channels), n);
+            if (r.pooled == nullptr)
+                continue;
+            r.input = k;
+            jobs[count++] = {inputs[k].source, juce::AudioSourceChannelInfo(&r.pooled->audio, 0, n)};
+        }
+        RenderPool::getInstance().render(jobs.data(), count);
+        for (auto &r : rendered)
+        {
+            if (r.input < 0)
+                continue;
+            auto &i = inputs[r.input];
+            float gain = i.gain->load(std::memory_order_relaxed);
+            if (gain != 0.0f)
+            {
+                float left, right;
+                panGains(gain, i.pan->load(std::memory_order_relaxed), left, right);
+                for (int channel = 0; channel < channels; ++channel)
+                {
+                    // mono and any channel past the stereo pair get the plain gain
+                    float g = channels != 2 ? gain : (channel == 0 ? left : right);
+                    juce::FloatVectorOperations::addWithMultiply(bufferToFill.buffer->getWritePointer(channel, bufferToFill.startSample),
+                                                                 r.pooled->audio.getReadPointer(channel), g, n);
+                }
+            }
+            ScratchPool::getInstance().release(r.pooled);
+            r.pooled = nullptr;
+            r.input = -1;
+        }
+        position += n;
+    }
+    // constant power pan with unity gain at the centre, -1 is hard left and 1 hard right
+    static void panGains(float gain, float pan, float &left, float &right)
+    {
+        float angle = (juce::jlimit(-1.0f, 1.0f, pan) + 1.0f) * juce::MathConstants<float>::pi * 0.25f;
+        left = gain * std::cos(angle) * juce::MathConstants<float>::sqrt2;
+        right = gain * std::sin(angle) * juce::MathConstants<float>::sqrt2;
+    }
+    void setPosition(int p) override
+    {
+        position = p;
+        for (auto &i : inputs)
+            i.source->setPosition(p);
+    }
+    int getCurrentPosition() override
+    {
+        return position;
+    }
+    int getLength() override
+    {
+        int length = 0;
+        for (auto &i : inputs)
+            length = std::max(length, i.source->getLength());
+        return length;
+    }
+    float getLengthInSeconds() override
+    {
+        float length = 0;
+        for (auto &i : inputs)
+            length = std::max(length, i.source->getLengthInSeconds());
+        return length;
+    }
+
+private:
+    // the block of one input
+    struct Rendered
+    {
+        ScratchPool::Buffer *pooled = nullptr;
+        // -1 when the input wasn't rendered in this block
+        int input = -1;
+    };
+    std::vector<Input> inputs;
+    // sized in prepareToPlay, one per input
+    std::vector<Rendered> rendered;
+    std::vector<RenderPool::Job> jobs;
+    int position;
 };
 
 class ConcatenationSource : public PositionableSource
@@ -467,7 +1316,7 @@ public:
         track_number = 0;
         global_position = 0;
     }
-    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override
+    void prepare(int samplesPerBlockExpected, double sampleRate) override
     {
         numOfTracks = sources.size();
         length = 0;
@@ -487,43 +1336,33 @@ public:
     }
     void getNextAudioBlock(const juce::AudioSourceChannelInfo &bufferToFill) override
     {
-        int remaining_samples = bufferToFill.buffer->getNumSamples();
-        while (remaining_samples > 0)
+        // every track renders straight into its part of the block
+        int offset = 0;
+        int remaining_samples = bufferToFill.numSamples;
+        while (remaining_samples > 0 && track_number < sources.size())
         {
             auto source = sources[track_number];
-            juce::AudioSourceChannelInfo currentTrackChannelInfo(bufferToFill);
             int track_remaining_samples = source->getLength() - source->getCurrentPosition();
             int num_samples = juce::jmin(remaining_samples, track_remaining_samples);
-            currentTrackChannelInfo.startSample = 0;
-            currentTrackChannelInfo.numSamples = num_samples;
-            source->getNextAudioBlock(currentTrackChannelInfo);
-            for (int channel = 0; channel < bufferToFill.buffer->getNumChannels(); ++channel)
+            if (num_samples > 0)
             {
-                auto *buffer = currentTrackChannelInfo.buffer->getReadPointer(channel, 0);
-                auto *output = bufferToFill.buffer->getWritePointer(channel, 0);
-                std::copy(buffer, buffer + num_samples, output);
+                source->getNextAudioBlock(juce::AudioSourceChannelInfo(bufferToFill.buffer, bufferToFill.startSample + offset, num_samples));
+                offset += num_samples;
+                remaining_samples -= num_samples;
+                global_position += num_samples;
             }
-            global_position += num_samples;
-            remaining_samples -= num_samples;
-            if (track_remaining_samples == 0)
+            if (num_samples < track_remaining_samples)
+                break;
+            if (track_number + 1 >= sources.size())
             {
-                if (sources.size() > (track_number + 1))
-                {
-                    track_number++;
-                }
-                else if (remaining_samples > 0 || num_samples == 0)
-                {
-                    // Fill remaining samples with zeros
-                    for (int channel = 0; channel < bufferToFill.buffer->getNumChannels(); ++channel)
-                    {
-                        auto *output = bufferToFill.buffer->getWritePointer(channel, 0);
-                        std::fill(output, output + remaining_samples, 0.0f);
-                    }
-                    global_position = getLength() + 1;
-                    return;
-                }
+                global_position = getLength() + 1;
+                break;
             }
+            track_number++;
         }
+        // fill what is left after the last track with zeros
+        for (int channel = 0; channel < bufferToFill.buffer->getNumChannels() && remaining_samples > 0; ++channel)
+            juce::FloatVectorOperations::clear(bufferToFill.buffer->getWritePointer(channel, bufferToFill.startSample + offset), remaining_samples);
     }
 
     void setPosition(int p) override
@@ -591,7 +1430,7 @@ public:
         source = nullptr;
         n = 0;
     }
-    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override
+    void prepare(int samplesPerBlockExpected, double sampleRate) override
     {
         length = 0;
         length = sampleRate * seconds;
@@ -603,74 +1442,38 @@ public:
     }
     void getNextAudioBlock(const juce::AudioSourceChannelInfo &bufferToFill) override
     {
-        // write to output till the audio not finished
-        juce::AudioSourceChannelInfo currentTrackCI(bufferToFill);
-        currentTrackCI.startSample = 0;
-        currentTrackCI.numSamples = juce::jmin(bufferToFill.numSamples, source->getLength() - source->getCurrentPosition());
-        source->getNextAudioBlock(currentTrackCI);
-        for (auto sample = 0; sample < currentTrackCI.numSamples; ++sample)
+        // the track renders straight into the block, once for every time it starts over
+        int offset = 0;
+        int remaining_samples = juce::jlimit(0, bufferToFill.numSamples, length - n);
+        int track_length = source->getLength();
+        while (remaining_samples > 0 && track_length > 0)
         {
-            for (auto channel = 0; channel < bufferToFill.buffer->getNumChannels(); ++channel)
+            int num_samples = juce::jmin(remaining_samples, track_length - source->getCurrentPosition());
+            if (num_samples > 0)
             {
-                auto buffer = currentTrackCI.buffer->getReadPointer(channel, bufferToFill.startSample);
-                auto output = bufferToFill.buffer->getWritePointer(channel, bufferToFill.startSample);
-                output[sample] = buffer[sample];
+                source->getNextAudioBlock(juce::AudioSourceChannelInfo(bufferToFill.buffer, bufferToFill.startSample + offset, num_samples));
+                offset += num_samples;
+                remaining_samples -= num_samples;
+                n += num_samples;
             }
-            n++;
-        }
-
-        if (source->getCurrentPosition() >= source->getLength())
-        {
             // if the track is ended, start it from beginning
-            source->setPosition(0);
-        }
-
-        // if the track ended in the middle of buffer
-        if (currentTrackCI.numSamples != bufferToFill.numSamples)
-        {
-            // if it was not the end
-            // fill the second part of block with the beginning of the track
-            if (n < length)
-            {
-                juce::AudioSourceChannelInfo nextTrackCI(bufferToFill);
-                nextTrackCI.startSample = 0;
-                nextTrackCI.numSamples = bufferToFill.numSamples - currentTrackCI.numSamples;
+            if (source->getCurrentPosition() >= track_length)
                 source->setPosition(0);
-                source->getNextAudioBlock(nextTrackCI);
-                for (auto sample = currentTrackCI.numSamples; sample < bufferToFill.numSamples; ++sample)
-                {
-                    for (auto channel = 0; channel < bufferToFill.buffer->getNumChannels(); ++channel)
-                    {
-                        auto buffer = nextTrackCI.buffer->getReadPointer(channel, 0);
-                        auto output = bufferToFill.buffer->getWritePointer(channel, bufferToFill.startSample);
-                        output[sample] = buffer[sample];
-                    }
-                    n++;
-                }
-                // switch to the beginning of the track
-                source->setPosition(0);
-            }
-            else
-            {
-                // if it is the end, fill with zeros
-                for (auto sample = currentTrackCI.numSamples; sample < bufferToFill.numSamples; ++sample)
-                {
-                    for (auto channel = 0; channel < bufferToFill.buffer->getNumChannels(); ++channel)
-                    {
-                        auto output = bufferToFill.buffer->getWritePointer(channel, bufferToFill.startSample);
-                        output[sample] = 0;
-                    }
-                    n++;
-                }
-            }
         }
+        // past the end, fill with zeros
+        int rest = bufferToFill.numSamples - offset;
+        for (int channel = 0; channel < bufferToFill.buffer->getNumChannels() && rest > 0; ++channel)
+            juce::FloatVectorOperations::clear(bufferToFill.buffer->getWritePointer(channel, bufferToFill.startSample + offset), rest);
+        n += rest;
     }
 
     void setPosition(int p) override
     {
         if (source == nullptr)
             return;
-        source->setPosition(p % source->getLength());
+        // an empty or unreadable track has no position to start over from
+        int track_length = source->getLength();
+        source->setPosition(track_length > 0 ? p % track_length : 0);
         n = p;
     }
 
@@ -703,7 +1506,7 @@ public:
         source = nullptr;
         n = 0;
     }
-    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override
+    void prepare(int samplesPerBlockExpected, double sampleRate) override
     {
         length = sampleRate * seconds;
         start = sampleRate * start_seconds;
@@ -754,6 +1557,13 @@ class ResamplingAudioSource : public PositionableSource
 public:
     ResamplingAudioSource(PositionableSource *source, float &samplesCoefficient) : samplesInPerOutputSample(samplesCoefficient)
     {
+        input = nullptr;
+        setSource(source);
+    }
+    void setSource(PositionableSource *source)
+    {
+        if (source == input)
+            return;
         input = source;
         resampling.reset(new juce::ResamplingAudioSource(input, false, 2));
         resampling->setResamplingRatio(samplesInPerOutputSample);
@@ -762,7 +1572,7 @@ public:
     {
         resampling->setResamplingRatio(samplesInPerOutputSample);
     }
-    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override
+    void prepare(int samplesPerBlockExpected, double sampleRate) override
     {
         resampling->prepareToPlay(samplesPerBlockExpected, sampleRate);
     }
@@ -812,10 +1622,13 @@ public:
     }
     void setSource(PositionableSource *s)
     {
+        if (s == source && r != nullptr)
+            return;
+        delete r;
         source = s;
         r = new juce::IIRFilterAudioSource(s, false);
     }
-    void prepareToPlay(int samplesPerBlockExpected, double _sampleRate) override
+    void prepare(int samplesPerBlockExpected, double _sampleRate) override
     {
         sampleRate = _sampleRate;
         update();
@@ -0,0 +1,101 @@
+#include <JuceHeader.h>
+#include "Check.h"
+#include "ClipCache.h"
+#include <random>
+
+using Storage = ClipCache::Storage;
+
+static juce::AudioBuffer<float> noise(int channels, int length, float peak)
+{
+    std::mt19937 random(3);
+    std::uniform_real_distribution<float> sample(-peak, peak);
+    juce::AudioBuffer<float> buffer(channels, length);
+    for (int c = 0; c < channels; c++)
+        for (int i = 0; i < length; i++)
+            buffer.getWritePointer(c)[i] = sample(random);
+    return buffer;
+}
+
+// the largest difference between what the clip reads from a position and the original
+static double roundTripError(Storage storage, const juce::AudioBuffer<float> &original, int from, int n)
+{
+    juce::AudioBuffer<float> copy(original.getNumChannels(), original.getNumSamples());
+    for (int c = 0; c < original.getNumChannels(); c++)
+        juce::FloatVectorOperations::copy(copy.getWritePointer(c), original.getReadPointer(c), original.getNumSamples());
+    ClipCache::Clip clip(std::move(copy), storage, 48000, 44100);
+    CHECK(clip.getNumChannels() == original.getNumChannels());
+    CHECK(clip.getNumSamples() == original.getNumSamples());
+    std::vector<float> out(n);
+    double error = 0;
+    for (int c = 0; c < original.getNumChannels(); c++)
+    {
+        clip.read(c, from, out.data(), n);
+        for (int i = 0; i < n; i++)
+        {
+            // packed samples are clipped to full scale
+            float expected = storage == Storage::float32 ? original.getReadPointer(c)[from + i]
+                                                         : juce::jlimit(-1.0f, 1.0f, original.getReadPointer(c)[from + i]);
+            error = std::max(error, (double)std::abs(out[i] - expected));
+        }
+    }
+    return error;
+}
+
+// each storage is exact to half a step of its resolution, read from any position
+static void packedSamplesRoundTrip()
+{
+    auto original = noise(2, 1000, 1.0f);
+    for (auto [from, n] : {std::pair<int, int>{0, 1000}, {1, 13}, {700, 300}, {999, 1}})
+    {
+        CHECK(roundTripError(Storage::float32, original, from, n) == 0);
+        CHECK(roundTripError(Storage::int16, original, from, n) <= 0.5 / 32767 + 1e-7);
+        CHECK(roundTripError(Storage::int24, original, from, n) <= 0.5 / 8388607 + 1e-7);
+    }
+}
+
+// values beyond full scale are clipped instead of wrapping around
+static void fullScaleIsClipped()
+{
+    auto loud = noise(1, 500, 1.5f);
+    CHECK(roundTripError(Storage::int16, loud, 0, 500) <= 0.5 / 32767 + 1e-7);
+    CHECK(roundTripError(Storage::int24, loud, 0, 500) <= 0.5 / 8388607 + 1e-7);
+    juce::AudioBuffer<float> edges(1, 4);
+    auto e = edges.getWritePointer(0);
+    e[0] = 1;
+    e[1] = -1;
+    e[2] = 0;
+    e[3] = -1.0f / 32767;
+    for (auto storage : {Storage::int16, Storage::int24})
+    {
+        juce::AudioBuffer<float> copy(1, 4);
+        juce::FloatVectorOperations::copy(copy.getWritePointer(0), e, 4);
+        ClipCache::Clip clip(std::move(copy), storage, 48000, 48000);
+        float out[4];
+        clip.read(0, 0, out, 4);
+        CHECK(out[0] == 1 && out[1] == -1 && out[2] == 0);
+        CHECK(std::abs(out[3] - e[3]) < 1e-7);
+    }
+}
+
+static void packedSizes()
+{
+    auto original = noise(2, 1000, 1.0f);
+    auto bytes = [&](Storage storage)
+    {
+        juce::AudioBuffer<float> copy(2, 1000);
+        for (int c = 0; c < 2; c++)
+            juce::FloatVectorOperations::copy(copy.getWritePointer(c), original.getReadPointer(c), 1000);
+        return ClipCache::Clip(std::move(copy), storage, 48000, 48000).bytes();
+    };
+    CHECK(bytes(Storage::float32) == 2 * 1000 * sizeof(float));
+    CHECK(bytes(Storage::int16) == 2 * 1000 * 2);
+    CHECK(bytes(Storage::int24) == 2 * 1000 * 3);
+}
+
+int main()
+{
+    packedSamplesRoundTrip();
+    fullScaleIsClipped();
+    packedSizes();
+    return failures == 0 ? 0 : 1;
+}
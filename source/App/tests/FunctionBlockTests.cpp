@@ -0,0 +1,106 @@
+#include <JuceHeader.h>
+#include "Check.h"
+#include "FunctionTree.h"
+#include <random>
+
+// a block of x with no value on the edge of a period, where the per sample and the
+// block versions may round to different sides
+static std::vector<double> inputs(int n)
+{
+    std::mt19937 random(1);
+    std::uniform_real_distribution<double> x(-40, 40);
+    std::vector<double> values;
+    const double edge = juce::MathConstants<double>::pi;
+    while ((int)values.size() < n)
+    {
+        double v = x(random);
+        double phase = std::fmod(std::abs(v), edge);
+        if (phase > 1e-6 && edge - phase > 1e-6)
+            values.push_back(v);
+    }
+    return values;
+}
+
+// process gives what get gives sample by sample, for blocks longer and shorter than max_block
+static void blockMatchesSamples(const char *name, F *f, double tolerance)
+{
+    for (int n : {1, 7, F::max_block, 3 * F::max_block + 5})
+    {
+        auto x = inputs(n);
+        std::vector<double> out(n);
+        f->process(x.data(), out.data(), n);
+        double error = 0;
+        for (int i = 0; i < n; i++)
+            error = std::max(error, std::abs(out[i] - f->get(x[i])));
+        if (error > tolerance)
+            std::cerr << name << " block of " << n << " differs by " << error << "\n";
+        CHECK(error <= tolerance);
+    }
+}
+
+// without its approximation a function gives exactly what get gives
+static void waveforms()
+{
+    for (bool fast : {true, false})
+    {
+        FastMath::enabled.fill(fast);
+        Tree t;
+        blockMatchesSamples("sine", *t.add(new Sine({})), fast ? 1e-7 : 0);
+        blockMatchesSamples("square", *t.add(new Square({})), 0);
+        blockMatchesSamples("sawtooth", *t.add(new Sawtooth({})), fast ? 1e-9 : 0);
+        blockMatchesSamples("triangle", *t.add(new Triangle({})), fast ? 1e-9 : 0);
+        float start = -0.5f, end = 2;
+        blockMatchesSamples("line", *t.add(new Line(start, end, {})), fast ? 1e-9 : 0);
+    }
+    FastMath::enabled.fill(true);
+}
+
+// turning off one approximation leaves the others on
+static void approximationPerFunction()
+{
+    Tree t;
+    F *sine = *t.add(new Sine({}));
+    F *sawtooth = *t.add(new Sawtooth({}));
+    auto x = inputs(FunctionProgram::max_block + 3);
+    int n = (int)x.size();
+    std::vector<double> fast(n), exact(n), out(n);
+    sawtooth->process(x.data(), fast.data(), n);
+    FastMath::enabled[FastMath::Sawtooth] = false;
+    sawtooth->process(x.data(), exact.data(), n);
+    FastMath::enabled[FastMath::Sawtooth] = true;
+
+    FastMath::enabled[FastMath::Sin] = false;
+    sine->process(x.data(), out.data(), n);
+    for (int i = 0; i < n; i++)
+        CHECK(out[i] == std::sin(x[i]));
+    sawtooth->process(x.data(), out.data(), n);
+    CHECK(out == fast);
+    CHECK(out != exact);
+    FastMath::enabled[FastMath::Sin] = true;
+}
+
+// the inputs of a function are evaluated a block at a time as well, x passes through
+// unconnected inputs
+static void trees()
+{
+    Tree t;
+    float a = 0.25f, start = 1, end = -1;
+    auto sine = t.add(new Sine({}));
+    auto line = t.add(new Line(start, end, {sine}));
+    auto constant = t.add(new Const(a));
+    auto product = t.add(new Multiply({line, constant}));
+    auto triangle = t.add(new Triangle({product}));
+    auto sum = t.add(new Add({triangle, nullptr}));
+    auto quotient = t.add(new Divide({sum, t.add(new Add({constant, constant}))}));
+    auto difference = t.add(new Substract({quotient, t.add(new Sawtooth({}))}));
+    auto root = t.add(new Concatenate({difference, t.add(new Square({sine}))}));
+    blockMatchesSamples("tree", *root, 1e-6);
+}
+
+int main()
+{
+    waveforms();
+    approximationPerFunction();
+    trees();
+    return failures == 0 ? 0 : 1;
+}
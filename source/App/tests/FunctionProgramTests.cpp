@@ -0,0 +1,135 @@
+#include <JuceHeader.h>
+#include "Check.h"
+#include "FunctionTree.h"
+
+struct Params
+{
+    float gain = 0.5f, start = -1, end = 1, offset = 0.1f;
+};
+
+// every instruction, uniform parts, a call to a function without an instruction and
+// inputs left unconnected
+static F *build(Tree &t, Params &p)
+{
+    auto sine = t.add(new Sine({}));
+    auto gain = t.add(new Const(p.gain));
+    auto uniform = t.add(new Add({gain, t.add(new Const(p.offset))}));
+    auto line = t.add(new Line(p.start, p.end, {sine}));
+    auto product = t.add(new Multiply({line, uniform}));
+    auto noise = t.add(new Multiply({t.add(new Random()), t.add(new Const(p.offset))}));
+    auto mixed = t.add(new Add({product, noise}));
+    auto shaped = t.add(new Triangle({t.add(new Substract({mixed, nullptr}))}));
+    auto divided = t.add(new Divide({t.add(new Sawtooth({})), uniform}));
+    auto first = t.add(new Add({shaped, divided}));
+    return *t.add(new Concatenate({first, t.add(new Square({}))}));
+}
+
+// the program gives what processBlock gives, block after block, as parameters change
+static void programMatchesBlocks()
+{
+    Params p;
+    Tree tree;
+    // the program has its own generator, so processBlock doesn't advance the program's noise
+    F *reference = build(tree, p);
+    FunctionProgram program;
+    program.compile(reference);
+    CHECK(!program.empty());
+
+    double x[FunctionProgram::max_block];
+    double expected[FunctionProgram::max_block], actual[FunctionProgram::max_block];
+    double t = -3;
+    for (int block = 0; block < 200; block++)
+    {
+        int n = 1 + block % FunctionProgram::max_block;
+        for (int i = 0; i < n; i++, t += 0.0137)
+            x[i] = t;
+        if (block == 100)
+        {
+            // parameters are read when the program runs, not when it is compiled
+            p.gain = 2;
+            p.start = 3;
+        }
+        reference->process(x, expected, n);
+        program.run(x, actual, n);
+        double error = 0;
+        for (int i = 0; i < n; i++)
+            error = std::max(error, std::abs(actual[i] - expected[i]));
+        if (error > 1e-9)
+            std::cerr << "block " << block << " differs by " << error << "\n";
+        CHECK(error <= 1e-9);
+    }
+}
+
+// an empty function is x
+static void emptyProgram()
+{
+    FunctionProgram program;
+    program.compile(nullptr);
+    double x[3] = {1, -2, 3}, out[3];
+    program.run(x, out, 3);
+    CHECK(out[0] == 1 && out[1] == -2 && out[2] == 3);
+}
+
+// a function that doesn't depend on x is folded when compiled and again after a
+// parameter it reads is edited
+static void constantsAreFolded()
+{
+    Tree t;
+    float a = 0.5f, b = 0.25f;
+    auto product = t.add(new Multiply({t.add(new Const(a)), t.add(new Const(b))}));
+    F *root = *t.add(new Add({t.add(new Sine({product})), t.add(new Sine({}))}));
+    FunctionProgram program;
+    program.compile(root);
+    // only the sine of x and the sum run every block
+    CHECK(program.size() == 2);
+    double x[FunctionProgram::max_block], out[FunctionProgram::max_block];
+    for (int i = 0; i < FunctionProgram::max_block; i++)
+        x[i] = i;
+    for (float edited : {0.5f, 2.0f})
+    {
+        a = edited;
+        program.run(x, out, FunctionProgram::max_block);
+        for (int i = 0; i < FunctionProgram::max_block; i++)
+            CHECK(std::abs(out[i] - std::sin(a * b) - std::sin(x[i])) < 1e-6);
+    }
+
+    Tree constant;
+    program.compile(*constant.add(new Sine({constant.add(new Const(a))})));
+    CHECK(program.size() == 0 && !program.empty());
+    program.run(x, out, 5);
+    for (int i = 0; i < 5; i++)
+        CHECK(std::abs(out[i] - std::sin(a)) < 1e-7);
+}
+
+// every program draws its own noise, however the programs of one tree are interleaved
+static void noisePerProgram()
+{
+    Params p;
+    Tree t;
+    F *root = build(t, p);
+    FunctionProgram first, second;
+    first.compile(root);
+    second.compile(root);
+    double x[FunctionProgram::max_block], a[FunctionProgram::max_block], b[FunctionProgram::max_block];
+    std::fill(x, x + FunctionProgram::max_block, 0.5);
+    std::vector<double> drawn;
+    for (int block = 0; block < 3; block++)
+    {
+        first.run(x, a, FunctionProgram::max_block);
+        drawn.insert(drawn.end(), a, a + FunctionProgram::max_block);
+    }
+    for (int block = 0; block < 3; block++)
+    {
+        second.run(x, b, FunctionProgram::max_block);
+        CHECK(std::equal(b, b + FunctionProgram::max_block, drawn.begin() + block * FunctionProgram::max_block));
+    }
+}
+
+int main()
+{
+    programMatchesBlocks();
+    emptyProgram();
+    constantsAreFolded();
+    noisePerProgram();
+    return failures == 0 ? 0 : 1;
+}
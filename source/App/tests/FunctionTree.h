@@ -0,0 +1,17 @@
+#pragma once
+#include "Functions.h"
+#include <deque>
+#include <memory>
+
+// owns the functions of a tree and the slots that connect them
+struct Tree
+{
+    std::deque<F *> slots;
+    std::vector<std::unique_ptr<F>> owned;
+    F **add(F *f)
+    {
+        owned.emplace_back(f);
+        slots.push_back(f);
+        return &slots.back();
+    }
+};
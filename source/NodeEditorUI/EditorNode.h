@@ -11,6 +11,12 @@ enum PinType
     Audio
 };
 
+template <>
+struct PinTraits<float>
+{
+    static const int type = PinType::Number;
+};
+
 class EditorNode : public Node
 {
 public:
@@ -31,7 +37,17 @@ public:
     {
         Node::registerInput(key, name, type);
         if (c != nullptr)
+        {
+            // like an internal component, the listeners rebuild what plays from the node
+            c->onChange = [this]()
+            {
+                if (graph != nullptr)
+                    graph->markDirty(this);
+                else
+                    markDirty();
+            };
             input_components[key] = c;
+        }
     }
 
     void registerInput(int key, const std::string &name, int type)
@@ -39,10 +55,21 @@ public:
         Node::registerInput(key, name, type);
     }
 
+    // internal components (files, operations) change what the node builds,
+    // so the graph listeners are told about it
     void registerInternal(ValueRefComponent *c)
     {
+        c->onChange = [this]()
+        {
+            if (graph != nullptr)
+                graph->markDirty(this);
+        };
         internal_components.push_back(c);
     }
+    // drops the sources of the previous build so the next build creates new ones
+    virtual void retireSources(){};
+    // how many pooled scratch buffers the node's sources take at once while rendering a block
+    virtual int getScratchBuffers() { return 0; };
 
     juce::Colour getPinColor(int type)
     {
@@ -73,17 +100,17 @@ public:
             return nullptr;
         return internal_components[0];
     };
-    int getConnectionsNumber()
+    // reads a connected number input and shows it on the input's component
+    bool readNumber(int key, float &value)
     {
-        int number_of_connections = 0;
-        for (auto &[_, input] : inputs)
-        {
-            number_of_connections += graph->getOutputsOfInputSize(input);
-        }
-        return number_of_connections;
+        if (!getInput(key, value))
+            return false;
+        auto it = input_components.find(key);
+        if (it != input_components.end())
+            it->second->update();
+        return true;
     }
     int x, y;
-    int type_id;
     std::unordered_map<int, ValueRefComponent *> input_components;
     std::vector<ValueRefComponent *> internal_components;
     // std::unique_ptr<Vertical> internal_component;
@@ -25,7 +25,7 @@ public:
         height = 0;
         height += theme->headerHeight;
 
-        for (auto &[_, p] : node->inputs)
+        for (auto p : node->inputs)
         {
             auto pin = new PinComponent(p);
             inputs.push_back(pin);
@@ -42,7 +42,7 @@ public:
                 height += in->getHeight();
             }
         }
-        for (auto &[_, p] : node->outputs)
+        for (auto p : node->outputs)
         {
             auto pin = new PinComponent(p);
             outputs.push_back(pin);
@@ -93,6 +93,41 @@ public:
         setSize(theme->nodeWidth, height);
     }
 
+    // adds components for the inputs the node added since, below the others. False when
+    // there were none
+    bool addInputs()
+    {
+        if (node->inputs.size() == (int)inputs.size())
+            return false;
+        int index = 0;
+        for (auto p : node->inputs)
+        {
+            if (index++ < (int)inputs.size())
+                continue;
+            auto pin = new PinComponent(p);
+            inputs.push_back(pin);
+            auto label = new juce::Label({}, p->name);
+            label->setFont(f);
+            label->setColour(juce::Label::textColourId, theme->nodeTextColor);
+            label->setJustificationType(juce::Justification::centredLeft);
+            label->setInterceptsMouseClicks(false, false);
+            inputNames.push_back(label);
+            addAndMakeVisible(label);
+            addAndMakeVisible(pin, 10);
+            height += spacing;
+            juce::Component *in = node->getInternal(p->key);
+            if (in != nullptr)
+            {
+                addAndMakeVisible(in);
+                height += in->getHeight();
+            }
+        }
+        setSize(theme->nodeWidth, height);
+        resized();
+        repaint();
+        return true;
+    }
+
     ~NodeComponent() override
     {
         for (auto &n : inputs)
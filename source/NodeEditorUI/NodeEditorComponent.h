@@ -11,17 +11,9 @@
 class NodeEditorComponent : public juce::Component, public GraphListener
 {
 public:
-    void message(std::string text) override
-    {
-        DBG(text);
-    };
     void NodeAdded(Node *node) override
     {
-        auto n = new NodeComponent(juce::Point<int>(10, 10), (EditorNode *)node);
-        node_components[node->id] = n;
-        n->addMouseListener(mouseListener.get(), true);
-        n->setTransform(getScaleTranform());
-        addAndMakeVisible(n);
+        addNodeComponent((EditorNode *)node, juce::Point<int>(10, 10));
     };
     void NodeDeleted(int id) override
     {
@@ -32,17 +24,17 @@ public:
     };
     void ConnectionAdded(Connection *c) override
     {
-        PinComponent *pin1 = node_components[c->getNodeFromId()]->outputs[c->getPinFromNumber()];
-        PinComponent *pin2 = node_components[c->getNodeToId()]->inputs[c->getPinToNumber()];
-        ConnectionComponent *con = new ConnectionComponent(pin1, pin2);
-        auto start = getLocalPoint(pin1, juce::Point<int>(0, 0)) + juce::Point<int>(theme->pinDiameter / 2, theme->pinDiameter / 2);
-        auto end = getLocalPoint(pin2, juce::Point<int>(0, 0)) + juce::Point<int>(theme->pinDiameter / 2, theme->pinDiameter / 2);
+        auto con = addConnectionComponent(c);
+        auto start = getLocalPoint(con->pin_from, juce::Point<int>(0, 0)) + juce::Point<int>(theme->pinDiameter / 2, theme->pinDiameter / 2);
+        auto end = getLocalPoint(con->pin_to, juce::Point<int>(0, 0)) + juce::Point<int>(theme->pinDiameter / 2, theme->pinDiameter / 2);
         con->calculateBounds(start, end);
-        connection_components[c->id] = con;
-        con->addMouseListener(mouseListener.get(), false);
-        addAndMakeVisible(con);
-        con->toBack();
     };
+    // a node that added inputs gets components for them
+    void NodeChanged(Node *node) override
+    {
+        if (node_components[node->id]->addInputs())
+            refreshConnections();
+    }
     void ConnectionDeleted(int con_id) override
     {
         auto c = connection_components[con_id];
@@ -50,6 +42,24 @@ public:
         removeChildComponent(c);
         connection_components.erase(con_id);
     }
+    // components of a whole batch are added first, the connection bounds are computed once after
+    void GraphChanged(const GraphChangeSet &changes) override
+    {
+        for (auto id : changes.deleted_connections)
+            ConnectionDeleted(id);
+        for (auto id : changes.deleted_nodes)
+            NodeDeleted(id);
+        for (auto &[id, node] : changes.added_nodes)
+        {
+            auto en = (EditorNode *)node;
+            addNodeComponent(en, juce::Point<int>(en->x, en->y));
+        }
+        for (auto &[id, node] : changes.changed_nodes)
+            node_components[id]->addInputs();
+        for (auto &[id, c] : changes.added_connections)
+            addConnectionComponent(c);
+        refreshConnections();
+    }
 
     struct NodeListener : public MouseListener
     {
@@ -132,20 +142,16 @@ public:
         }
         connection_components.clear();
 
-        int i = 0;
-        for (auto &[id, n] : graph->getNodes())
-        {
-            EditorNode *en = (EditorNode *)n;
-            node_components[id] = new NodeComponent(juce::Point<int>(en->x, en->y), en);
-            i++;
-        };
+        graph->forEachNode([this](Node *n)
+                           {
+                               EditorNode *en = (EditorNode *)n;
+                               node_components[n->id] = new NodeComponent(juce::Point<int>(en->x, en->y), en); });
 
-        for (auto &[id, c] : graph->getConnections())
-        {
-            PinComponent *pin1 = node_components[c->getNodeFromId()]->outputs[c->getPinFromNumber()];
-            PinComponent *pin2 = node_components[c->getNodeToId()]->inputs[c->getPinToNumber()];
-            connection_components[id] = new ConnectionComponent(pin1, pin2);
-        };
+        graph->forEachConnection([this](Connection *c)
+                                 {
+                                     PinComponent *pin1 = node_components[c->getNodeFromId()]->outputs[c->getPinFromNumber()];
+                                     PinComponent *pin2 = node_components[c->getNodeToId()]->inputs[c->getPinToNumber()];
+                                     connection_components[c->id] = new ConnectionComponent(pin1, pin2); });
 
         for (auto &[_, n] : node_components)
         {
@@ -237,6 +243,7 @@ public:
     };
     void deleteSelected()
     {
+        GraphBatch batch(graph);
         std::vector<int> ids = getSelectedNodes();
         for (auto &id : ids)
         {
@@ -408,4 +415,26 @@ private:
     {
         return juce::AffineTransform::scale(float(scale) / 100.0);
     }
+    // shared by single and batched notifications
+    NodeComponent *addNodeComponent(EditorNode *node, juce::Point<int> position)
+    {
+        auto n = new NodeComponent(position, node);
+        node_components[node->id] = n;
+        n->addMouseListener(mouseListener.get(), true);
+        n->setTransform(getScaleTranform());
+        addAndMakeVisible(n);
+        return n;
+    }
+    // the bounds are computed by the caller
+    ConnectionComponent *addConnectionComponent(Connection *c)
+    {
+        PinComponent *pin1 = node_components[c->getNodeFromId()]->outputs[c->getPinFromNumber()];
+        PinComponent *pin2 = node_components[c->getNodeToId()]->inputs[c->getPinToNumber()];
+        auto con = new ConnectionComponent(pin1, pin2);
+        connection_components[c->id] = con;
+        con->addMouseListener(mouseListener.get(), false);
+        addAndMakeVisible(con);
+        con->toBack();
+        return con;
+    }
 };
@@ -138,49 +138,114 @@ public:
     }
     void clear_graph()
     {
-        for (auto &[_, n] : nodes)
-            delete n;
-        nodes.clear();
-        for (auto &[_, n] : connections)
-            delete n;
-        connections.clear();
+        Graph::clear();
     }
     void recover(GraphInfo info, TypesRecoverFactory *factory)
     {
+        GraphBatch batch(this);
+        beginRecover(info);
+        std::vector<int> ids;
+        ids.reserve(info.nodes.size());
+        for (auto &[id, node_info] : info.nodes)
+            ids.push_back(id);
+        recoverNodes(info, ids, factory);
+        recoverConnections(info);
+    }
+    // a large graph can be recovered a few nodes at a time: beginRecover, then recoverNodes
+    // for every part of the nodes, then recoverConnections once all nodes are there
+    void beginRecover(const GraphInfo &info)
+    {
+        GraphBatch batch(this);
         clear_graph();
-        for (auto &[id, info] : info.nodes)
+        nodes.reserve(info.nodes.size());
+        connections.reserve(info.connections.size());
+        // nodes added in between don't take the ids of nodes still to be recovered
+        for (auto &[id, node_info] : info.nodes)
+            Graph::auto_increment = std::max(id, Graph::auto_increment);
+        for (auto &[id, connection_info] : info.connections)
+            Graph::auto_increment = std::max(id, Graph::auto_increment);
+    }
+    void recoverNodes(const GraphInfo &info, const std::vector<int> &ids, TypesRecoverFactory *factory)
+    {
+        GraphBatch batch(this);
+        for (int id : ids)
         {
-            auto node = factory->getNode(info.type_id);
+            auto &node_info = info.nodes.at(id);
+            auto node = factory->getNode(node_info.type_id);
             nodes[id] = node;
             node->id = id;
             node->graph = this;
-            Graph::auto_increment = std::max(id, Graph::auto_increment);
-            for (auto &[in_id, val] : info.input_values)
+            indexNode(node);
+            for (auto &[in_id, val] : node_info.input_values)
             {
-                node->input_components[in_id]->fromString(val);
-                node->input_components[in_id]->update();
+                // a node that adds inputs as they are connected adds the saved ones now
+                node->requireInput(in_id);
+                auto component = node->input_components.find(in_id);
+                if (component == node->input_components.end())
+                    continue;
+                component->second->fromString(val);
+                component->second->update();
             }
-            for (int i = 0; i < info.internal_values.size(); i++)
+            for (int i = 0; i < node_info.internal_values.size(); i++)
             {
-                auto &string = info.internal_values[i];
+                auto &string = node_info.internal_values[i];
                 node->internal_components[i]->fromString(string);
                 node->internal_components[i]->update();
             }
-            node->x = info.x;
-            node->y = info.y;
+            node->x = node_info.x;
+            node->y = node_info.y;
+            notifyNodeAdded(node);
         }
-        for (auto &[id, info] : info.connections)
+    }
+    void recoverConnections(const GraphInfo &info)
+    {
+        GraphBatch batch(this);
+        // every pin's connection list is allocated once
+        std::unordered_map<Pin *, int> counts;
+        forEachRecoveredConnection(info, [&](int, Output *from, Input *to)
+                                   {
+                                       counts[from]++;
+                                       counts[to]++; });
+        for (auto &[pin, count] : counts)
+            reserveConnections(pin, pin->connections.size() + count);
+        forEachRecoveredConnection(info, [&](int id, Output *pin1, Input *pin2)
+                                   {
+                                       Connection *connection = createConnection(pin1, pin2);
+                                       try
+                                       {
+                                           orderConnection(connection);
+                                       }
+                                       catch (const std::invalid_argument &)
+                                       {
+                                           // files saved before cycles were rejected can contain them, such connections are dropped
+                                           connection_pool.destroy(connection);
+                                           return;
+                                       }
+                                       connection->id = id;
+                                       connections[id] = connection;
+                                       linkConnection(connection);
+                                       notifyConnectionAdded(connection); });
+    }
+    template <class Visit>
+    void forEachRecoveredConnection(const GraphInfo &info, Visit visit)
+    {
+        for (auto &[id, connection_info] : info.connections)
         {
-            auto pin1 = nodes[info.node_from_id]->outputs[info.pin_from_number];
-            auto pin2 = nodes[info.node_to_id]->inputs[info.pin_to_number];
-            ConnectionBuilder factory;
-            factory.addPin(pin1);
-            factory.addPin(pin2);
-            Connection *connection;
-            connection = factory.build();
-            connection->id = id;
-            connections[id] = connection;
-            Graph::auto_increment = std::max(id, Graph::auto_increment);
+            // a node may have been deleted while the graph was recovered
+            auto from = nodes.find(connection_info.node_from_id);
+            auto to = nodes.find(connection_info.node_to_id);
+            if (from == nodes.end() || to == nodes.end())
+                continue;
+            // the node may be shown already, then the listeners are told about inputs it added
+            auto node = to->second;
+            int pins = node->inputs.size();
+            node->requireInput(connection_info.pin_to_number);
+            if (node->inputs.size() != pins)
+                notifyNodeChanged(node);
+            auto pin1 = from->second->outputs[connection_info.pin_from_number];
+            auto pin2 = node->inputs[connection_info.pin_to_number];
+            if (pin1 != nullptr && pin2 != nullptr)
+                visit(id, pin1, pin2);
         }
     }
 
@@ -27,6 +27,8 @@ public:
         update();
     }
     virtual void update() = 0;
+    // called when the user changes the value
+    std::function<void()> onChange;
 
     void resized() override
     {
@@ -0,0 +1,119 @@
+#include "Arena.h"
+#include <algorithm>
+#include <new>
+
+static std::size_t roundUp(std::size_t size, std::size_t to)
+{
+    return (size + to - 1) / to * to;
+}
+
+FixedSizePool::FixedSizePool(std::size_t _block_size, std::size_t _blocks_per_chunk)
+    : block_size(roundUp(std::max(_block_size, sizeof(FreeBlock)), alignof(std::max_align_t))),
+      blocks_per_chunk(_blocks_per_chunk), free_list(nullptr){};
+
+void FixedSizePool::grow()
+{
+    std::size_t bytes = block_size * blocks_per_chunk;
+    chunks.emplace_back(new std::max_align_t[roundUp(bytes, sizeof(std::max_align_t)) / sizeof(std::max_align_t)]);
+    auto base = (char *)chunks.back().get();
+    for (std::size_t i = blocks_per_chunk; i-- > 0;)
+    {
+        auto block = (FreeBlock *)(base + i * block_size);
+        block->next = free_list;
+        free_list = block;
+    }
+};
+
+void *FixedSizePool::allocate()
+{
+    if (free_list == nullptr)
+        grow();
+    FreeBlock *block = free_list;
+    free_list = block->next;
+    return block;
+};
+
+void FixedSizePool::deallocate(void *pointer)
+{
+    auto block = (FreeBlock *)pointer;
+    block->next = free_list;
+    free_list = block;
+};
+
+void FixedSizePool::release()
+{
+    chunks.clear();
+    free_list = nullptr;
+};
+
+static std::size_t capacityClass(int capacity)
+{
+    std::size_t index = 0;
+    while (((std::size_t)1 << index) < (std::size_t)capacity)
+        index++;
+    return index;
+}
+
+void **PointerArrayPool::allocate(int capacity)
+{
+    auto index = capacityClass(capacity);
+    while (pools.size() <= index)
+    {
+        // small arrays are the common case, a chunk holds fewer of the larger ones
+        std::size_t size = (std::size_t)1 << pools.size();
+        pools.emplace_back(size * sizeof(void *), std::max<std::size_t>(4, 256 / size));
+    }
+    return (void **)pools[index].allocate();
+};
+
+void PointerArrayPool::deallocate(void **array, int capacity)
+{
+    if (array != nullptr)
+        pools[capacityClass(capacity)].deallocate(array);
+};
+
+void PointerArrayPool::release()
+{
+    for (auto &pool : pools)
+        pool.release();
+};
+
+SlabAllocator &SlabAllocator::getInstance()
+{
+    // never destroyed, so nodes deleted during static destruction still find their pool
+    static SlabAllocator *instance = new SlabAllocator();
+    return *instance;
+};
+
+SlabAllocator::SlabAllocator()
+{
+    for (std::size_t size = granularity; size <= max_block; size += granularity)
+        pools.emplace_back(size, 64);
+};
+
+void *SlabAllocator::allocate(std::size_t size)
+{
+    if (size == 0 || size > max_block)
+        return ::operator new(size);
+    return pools[(size - 1) / granularity].allocate();
+};
+
+void SlabAllocator::deallocate(void *pointer, std::size_t size)
+{
+    if (pointer == nullptr)
+        return;
+    if (size == 0 || size > max_block)
+        return ::operator delete(pointer);
+    pools[(size - 1) / granularity].deallocate(pointer);
+};
+
+StringPool &StringPool::getInstance()
+{
+    static StringPool *instance = new StringPool();
+    return *instance;
+};
+
+const char *StringPool::intern(const std::string &string)
+{
+    return strings.insert(string).first->c_str();
+};
@@ -0,0 +1,101 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// hands out blocks of one size, carved from chunks that are only freed together
+class FixedSizePool
+{
+public:
+    FixedSizePool(std::size_t block_size, std::size_t blocks_per_chunk = 256);
+    FixedSizePool(const FixedSizePool &) = delete;
+    FixedSizePool &operator=(const FixedSizePool &) = delete;
+    FixedSizePool(FixedSizePool &&) = default;
+    void *allocate();
+    void deallocate(void *block);
+    // frees every chunk at once, blocks still in use become invalid
+    void release();
+
+private:
+    struct FreeBlock
+    {
+        FreeBlock *next;
+    };
+    void grow();
+    std::size_t block_size;
+    std::size_t blocks_per_chunk;
+    std::vector<std::unique_ptr<std::max_align_t[]>> chunks;
+    FreeBlock *free_list;
+};
+
+// slab of objects of one type
+template <class T, std::size_t ChunkSize = 256>
+class ObjectPool
+{
+public:
+    ObjectPool() : pool(sizeof(T), ChunkSize){};
+    template <class... Args>
+    T *create(Args &&...args)
+    {
+        return new (pool.allocate()) T(std::forward<Args>(args)...);
+    };
+    void destroy(T *object)
+    {
+        object->~T();
+        pool.deallocate(object);
+    };
+    // every object has to be destroyed before
+    void release()
+    {
+        pool.release();
+    };
+
+private:
+    FixedSizePool pool;
+};
+
+// arrays of pointers with a power of two capacity, a freed array is reused for the next
+// array of the same capacity
+class PointerArrayPool
+{
+public:
+    void **allocate(int capacity);
+    void deallocate(void **array, int capacity);
+    // frees every array at once, arrays still in use become invalid
+    void release();
+
+private:
+    // one pool per capacity, index i holds arrays of 2^i pointers
+    std::vector<FixedSizePool> pools;
+};
+
+// size classes used by Node::operator new, only used from the message thread
+class SlabAllocator
+{
+public:
+    static SlabAllocator &getInstance();
+    void *allocate(std::size_t size);
+    void deallocate(void *pointer, std::size_t size);
+
+private:
+    SlabAllocator();
+    static const std::size_t granularity = 64;
+    static const std::size_t max_block = 4096;
+    std::vector<FixedSizePool> pools;
+};
+
+// strings shared by every object that uses them, such as the pin names every node of a
+// type repeats. Interned strings are never freed, only used from the message thread
+class StringPool
+{
+public:
+    static StringPool &getInstance();
+    const char *intern(const std::string &string);
+
+private:
+    StringPool() = default;
+    std::unordered_set<std::string> strings;
+};
@@ -0,0 +1,68 @@
+#include "GraphCompiler.h"
+
+void ExecutionPlan::propagate()
+{
+    for (auto &node : order)
+    {
+        for (auto pin : node->inputs)
+        {
+            for (auto &c : pin->connections)
+            {
+                if (node->dirty)
+                    break;
+                if (c->pin_from->node->dirty)
+                    node->dirty = true;
+            }
+        }
+    }
+};
+
+void ExecutionPlan::execute()
+{
+    NODEGRAPH_TRACE(TraceLevel::Build, TraceEvent::BuildStarted, (int)order.size());
+    propagate();
+    for (auto &node : order)
+    {
+        if (node->dirty)
+        {
+            node->process();
+            NODEGRAPH_TRACE(TraceLevel::Build, TraceEvent::NodeProcessed, node->id);
+        }
+    }
+    for (auto &node : order)
+    {
+        node->dirty = false;
+    }
+    NODEGRAPH_TRACE(TraceLevel::Build, TraceEvent::BuildFinished, (int)order.size());
+};
+
+void GraphCompiler::validate(Connection *connection)
+{
+    auto from = connection->pin_from;
+    auto to = connection->pin_to;
+    if (from == nullptr || to == nullptr || from->isInput() || !to->isInput() || from->type != to->type)
+    {
+        throw std::invalid_argument("Connection " + std::to_string(connection->id) + " is not valid");
+    }
+    if (from->node->order_index >= to->node->order_index)
+    {
+        throw std::invalid_argument("Graph contains a cycle");
+    }
+};
+
+ExecutionPlan GraphCompiler::compile(Graph *graph)
+{
+    ExecutionPlan plan;
+    graph->forEachConnection([this](Connection *c)
+                             { validate(c); });
+
+    // the graph keeps its nodes in topological order, only the holes of deleted nodes are skipped
+    auto order = graph->getOrder();
+    plan.order.reserve(graph->getNodes().size());
+    for (auto n : order)
+    {
+        if (n != nullptr)
+            plan.order.push_back(n);
+    }
+    return plan;
+};
@@ -0,0 +1,23 @@
+#pragma once
+#include "NodeGraph.h"
+
+class ExecutionPlan
+{
+public:
+    // nodes in topological order, every node comes after all of its inputs
+    std::vector<Node *> order;
+    // marks everything downstream of a dirty node dirty, these are the nodes execute processes
+    void propagate();
+    // processes the dirty nodes and everything downstream of them
+    void execute();
+};
+
+class GraphCompiler
+{
+public:
+    // throws std::invalid_argument if a connection is not valid or the graph has a cycle
+    ExecutionPlan compile(Graph *graph);
+
+private:
+    void validate(Connection *connection);
+};
@@ -1,9 +1,11 @@
 #include "NodeGraph.h"
+#include <algorithm>
+#include <unordered_set>
 
-Pin::Pin(int _key, std::string _name, int _type, Node *_node)
-    : key(_key), name(_name), type(_type), node(_node) {}
-Output::Output(int _key, std::string _name, int _type, Node *_node) : Pin(_key, _name, _type, _node){};
-Input::Input(int _key, std::string _name, int _type, Node *_node) : Pin(_key, _name, _type, _node){};
+Pin::Pin(int _key, const std::string &_name, int _type, Node *_node)
+    : key(_key), name(StringPool::getInstance().intern(_name)), type(_type), node(_node) {}
+Output::Output(int _key, const std::string &_name, int _type, Node *_node) : Pin(_key, _name, _type, _node){};
+Input::Input(int _key, const std::string &_name, int _type, Node *_node) : Pin(_key, _name, _type, _node){};
 
 bool Input::isInput()
 {
@@ -29,28 +31,51 @@ Node::Node()
 {
     graph = nullptr;
     id = -1;
+    type_id = -1;
+    dirty = true;
+    order_index = -1;
 };
-Node::~Node()
+Node::~Node(){};
+void *Node::operator new(std::size_t size)
 {
-    for (auto &[_, n] : inputs)
-        delete n;
-    inputs.clear();
-    for (auto &[_, n] : outputs)
-        delete n;
-    outputs.clear();
+    return SlabAllocator::getInstance().allocate(size);
+};
+void Node::operator delete(void *pointer, std::size_t size)
+{
+    SlabAllocator::getInstance().deallocate(pointer, size);
 };
 
-void Node::trigger(Value &d, [[maybe_unused]] Input *pin) {
+void Node::process(){
 
+};
+void Node::markDirty()
+{
+    dirty = true;
 };
 void Node::registerInput(int key, const std::string &name, int type)
 {
-    inputs[key] = new Input(key, name, type, this);
-    // inputs.push_back(Input(inputs.size(), name, type, this));
+    inputs.add(Input(key, name, type, this));
 };
 void Node::registerOutput(int key, const std::string &name, int type)
 {
-    outputs[key] = new Output(key, name, type, this);
+    outputs.add(Output(key, name, type, this));
+};
+Value *Node::getInputValue(int key)
+{
+    Input *input = inputs[key];
+    if (input == nullptr || input->connections.empty())
+        return nullptr;
+    Value *value = &input->connections.back()->value;
+    if (value->empty())
+        return nullptr;
+    return value;
+};
+void Node::setOutputValue(int key, Value value)
+{
+    Output *output = outputs[key];
+    if (output == nullptr)
+        return;
+    graph->triggerPin(output, value);
 };
 
 Connection::Connection(Output *from, Input *to)
@@ -85,7 +110,7 @@ void ConnectionBuilder::addPin(Pin *pin)
 {
     pin->accept(this);
 }
-Connection *ConnectionBuilder::build()
+Connection *ConnectionBuilder::build(ObjectPool<Connection> &pool)
 {
     if (input == nullptr || output == nullptr)
     {
@@ -95,100 +120,293 @@ Connection *ConnectionBuilder::build()
     {
         throw std::invalid_argument("Pins are not valid");
     }
-    return new Connection(output, input);
+    return pool.create(output, input);
 }
 
 Graph::Graph()
 {
     auto_increment = 0;
+    version = 0;
+    order_holes = 0;
+    batch_depth = 0;
     deletion_allowed = true;
 };
-std::unordered_map<int, Node *> Graph::getNodes()
+const std::unordered_map<int, Node *> &Graph::getNodes() const
 {
     return nodes;
 };
-std::unordered_map<int, Connection *> Graph::getConnections()
+const std::unordered_map<int, Connection *> &Graph::getConnections() const
 {
     return connections;
 };
+Span<Connection *const> Graph::getPinConnections(Pin *pin) const
+{
+    return Span<Connection *const>(pin->connections.data(), pin->connections.size());
+};
 Graph::~Graph()
 {
+    clear();
+};
+void Graph::clear()
+{
+    if (batch_depth > 0)
+    {
+        for (auto &[id, _] : connections)
+            pending.connectionDeleted(id);
+        for (auto &[id, _] : nodes)
+            pending.nodeDeleted(id);
+    }
+    // the nodes may outlive the graph in the deleter, so their pins must not keep pointers
+    // into the storage released here
     for (auto &[_, n] : nodes)
-        delete n;
-    nodes.clear();
-    for (auto &[_, n] : connections)
-        delete n;
+    {
+        for (auto pin : n->inputs)
+            pin->connections = ConnectionList();
+        for (auto pin : n->outputs)
+            pin->connections = ConnectionList();
+    }
+    for (auto &[_, c] : connections)
+        connection_pool.destroy(c);
     connections.clear();
+    connection_pool.release();
+    list_storage.release();
+    for (auto &[_, n] : nodes)
+    {
+        if (node_deleter != nullptr)
+            node_deleter(n);
+        else
+            delete n;
+    }
+    nodes.clear();
+    nodes_by_type.clear();
+    order.clear();
+    order_holes = 0;
+    version++;
 };
 void Graph::addNode(Node *node)
 {
     node->graph = this;
     node->id = getId();
     nodes[auto_increment] = node;
-    for (auto &l : listeners)
-    {
-        l->NodeAdded(node);
-    };
+    indexNode(node);
+    notifyNodeAdded(node);
 };
 
-void Graph::triggerPin(Output *pin, Value &data)
+void Graph::indexNode(Node *node)
 {
-    for (auto &[id, c] : connections)
+    nodes_by_type[node->type_id][node->id] = node;
+    node->order_index = (int)order.size();
+    order.push_back(node);
+    version++;
+}
+
+void Graph::unindexNode(Node *node)
+{
+    order[node->order_index] = nullptr;
+    node->order_index = -1;
+    order_holes++;
+    if (order_holes * 2 > (int)order.size())
+    {
+        order.erase(std::remove(order.begin(), order.end(), nullptr), order.end());
+        for (int i = 0; i < (int)order.size(); i++)
+            order[i]->order_index = i;
+        order_holes = 0;
+    }
+    auto it = nodes_by_type.find(node->type_id);
+    version++;
+    if (it == nodes_by_type.end())
+        return;
+    it->second.erase(node->id);
+}
+
+const std::unordered_map<int, Node *> &Graph::getNodesOfType(int type_id)
+{
+    return nodes_by_type[type_id];
+}
+
+Span<Node *const> Graph::getOrder() const
+{
+    return Span<Node *const>(order.data(), order.size());
+}
+
+// Pearce-Kelly: only the nodes between the two ends of the new connection are visited and moved
+void Graph::orderConnection(Connection *connection)
+{
+    Node *from = connection->pin_from->node;
+    Node *to = connection->pin_to->node;
+    int lower = to->order_index;
+    int upper = from->order_index;
+    if (lower > upper)
+        return;
+
+    std::vector<Node *> forward;
+    std::vector<Node *> backward;
+    std::vector<Node *> stack = {to};
+    std::unordered_set<Node *> visited = {to};
+    while (!stack.empty())
     {
-        if (c->pin_from == pin)
-        {
-            auto node = c->pin_to->node;
-            node->trigger(data, c->pin_to);
-            for (auto &l : listeners)
+        Node *n = stack.back();
+        stack.pop_back();
+        if (n == from)
+            throw std::invalid_argument("Connection creates a cycle");
+        forward.push_back(n);
+        for (auto pin : n->outputs)
+            for (auto c : pin->connections)
             {
-                l->message("connection " + std::to_string(id) + " is triggered");
-            };
-        }
+                Node *next = c->pin_to->node;
+                if (next->order_index <= upper && visited.insert(next).second)
+                    stack.push_back(next);
+            }
     }
-};
+    stack = {from};
+    visited = {from};
+    while (!stack.empty())
+    {
+        Node *n = stack.back();
+        stack.pop_back();
+        backward.push_back(n);
+        for (auto pin : n->inputs)
+            for (auto c : pin->connections)
+            {
+                Node *previous = c->pin_from->node;
+                if (previous->order_index >= lower && visited.insert(previous).second)
+                    stack.push_back(previous);
+            }
+    }
+
+    auto by_index = [](Node *a, Node *b)
+    { return a->order_index < b->order_index; };
+    std::sort(forward.begin(), forward.end(), by_index);
+    std::sort(backward.begin(), backward.end(), by_index);
+    std::vector<int> slots;
+    slots.reserve(forward.size() + backward.size());
+    for (auto n : backward)
+        slots.push_back(n->order_index);
+    for (auto n : forward)
+        slots.push_back(n->order_index);
+    std::sort(slots.begin(), slots.end());
+    // everything upstream of the new connection goes before everything downstream
+    int i = 0;
+    for (auto n : backward)
+        n->order_index = slots[i++];
+    for (auto n : forward)
+        n->order_index = slots[i++];
+    for (auto n : backward)
+        order[n->order_index] = n;
+    for (auto n : forward)
+        order[n->order_index] = n;
+    version++;
+}
+
+void Graph::linkConnection(Connection *connection)
+{
+    appendConnection(connection->pin_from, connection);
+    appendConnection(connection->pin_to, connection);
+    connection->pin_from->node->markDirty();
+    connection->pin_to->node->markDirty();
+    // the listeners are told about inputs the node added
+    Node *node = connection->pin_to->node;
+    int pins = node->inputs.size();
+    node->inputConnected(connection->pin_to);
+    if (node->inputs.size() != pins)
+        notifyNodeChanged(node);
+    version++;
+}
 
-std::vector<Input *> Graph::getInputsOfOutput(Output *pin)
+void Graph::unlinkConnection(Connection *connection)
 {
-    std::vector<Input *> pins;
-    for (auto &[id, c] : connections)
+    for (Pin *pin : {(Pin *)connection->pin_from, (Pin *)connection->pin_to})
     {
-        if (c->pin_from == pin)
-        {
-            pins.push_back(c->pin_to);
-        }
+        removeConnection(pin, connection);
+        pin->node->markDirty();
     }
-    return pins;
+    version++;
 }
 
-int Graph::getOutputsOfInputSize(Input *pin)
+void Graph::appendConnection(Pin *pin, Connection *connection)
+{
+    auto &list = pin->connections;
+    if (list.count == list.capacity)
+        reserveConnections(pin, list.capacity == 0 ? 1 : list.capacity * 2);
+    list.items[list.count++] = connection;
+}
+
+void Graph::removeConnection(Pin *pin, Connection *connection)
+{
+    auto &list = pin->connections;
+    auto it = std::find(list.items, list.items + list.count, connection);
+    if (it == list.items + list.count)
+        return;
+    // keeps the order, the last connection of an input is the one that is read
+    std::copy(it + 1, list.items + list.count, it);
+    if (--list.count == 0)
+        releaseConnections(pin);
+}
+
+void Graph::reserveConnections(Pin *pin, int capacity)
+{
+    auto &list = pin->connections;
+    if (capacity <= list.capacity)
+        return;
+    int rounded = 1;
+    while (rounded < capacity)
+        rounded *= 2;
+    auto items = (Connection **)list_storage.allocate(rounded);
+    std::copy(list.items, list.items + list.count, items);
+    list_storage.deallocate((void **)list.items, list.capacity);
+    list.items = items;
+    list.capacity = rounded;
+}
+
+void Graph::releaseConnections(Pin *pin)
+{
+    auto &list = pin->connections;
+    list_storage.deallocate((void **)list.items, list.capacity);
+    list = ConnectionList();
+}
+
+void Graph::triggerPin(Output *pin, Value &data)
 {
-    std::vector<Output *> pins;
-    for (auto &[id, c] : connections)
+    assert(data.empty() || data.type == pin->type);
+    for (auto &c : pin->connections)
     {
-        if (c->pin_to == pin)
-        {
-            pins.push_back(c->pin_from);
-        }
+        c->value = data;
+        NODEGRAPH_TRACE(TraceLevel::Connection, TraceEvent::ConnectionTriggered, c->id);
     }
-    return pins.size();
+};
+
+int Graph::getOutputsOfInputSize(Input *pin)
+{
+    return (int)pin->connections.size();
 }
 
 Connection *Graph::addConnection(Pin *pin1, Pin *pin2)
 {
-    ConnectionBuilder factory;
-    factory.addPin(pin1);
-    factory.addPin(pin2);
-    Connection *connection;
-    connection = factory.build();
+    Connection *connection = createConnection(pin1, pin2);
+    try
+    {
+        orderConnection(connection);
+    }
+    catch (const std::invalid_argument &)
+    {
+        connection_pool.destroy(connection);
+        throw;
+    }
     connection->id = getId();
     connections[auto_increment] = (connection);
-    for (auto &l : listeners)
-    {
-        l->ConnectionAdded(connection);
-    };
+    linkConnection(connection);
+    notifyConnectionAdded(connection);
     return connection;
 };
 
+Connection *Graph::createConnection(Pin *pin1, Pin *pin2)
+{
+    ConnectionBuilder factory;
+    factory.addPin(pin1);
+    factory.addPin(pin2);
+    return factory.build(connection_pool);
+}
+
 int Graph::getId()
 {
     auto_increment++;
@@ -198,56 +416,54 @@ int Graph::getId()
 std::vector<int> Graph::getConnectionsOfNode(int node_id)
 {
     std::vector<int> ids;
-    for (auto &[id, c] : connections)
-    {
-        if (c->getNodeToId() == node_id || c->getNodeFromId() == node_id)
-        {
-            ids.push_back(id);
-        }
-    }
-
+    forEachConnectionOfNode(node_id, [&](Connection *c)
+                            { ids.push_back(c->id); });
     return ids;
 };
 std::vector<int> Graph::getInputConnectionsOfNode(int node_id)
 {
     std::vector<int> ids;
-    for (auto &[id, c] : connections)
+    auto it = nodes.find(node_id);
+    if (it == nodes.end())
+        return ids;
+    for (auto pin : it->second->inputs)
     {
-        if (c->getNodeToId() == node_id)
-        {
-            ids.push_back(id);
-        }
+        for (auto &c : pin->connections)
+            ids.push_back(c->id);
     }
-
     return ids;
 };
 
 void Graph::deleteConnection(int id)
 {
-    delete connections[id];
-    connections.erase(id);
-    for (auto &l : listeners)
-    {
-        l->ConnectionDeleted(id);
-    };
+    auto it = connections.find(id);
+    if (it == connections.end())
+        return;
+    unlinkConnection(it->second);
+    connection_pool.destroy(it->second);
+    connections.erase(it);
+    notifyConnectionDeleted(id);
 }
 bool Graph::deleteNode(int id)
 {
     if (!deletion_allowed)
         return false;
+    auto it = nodes.find(id);
+    if (it == nodes.end())
+        return false;
     auto connections_ids = getConnectionsOfNode(id);
     for (auto &con_id : connections_ids)
     {
         Graph::deleteConnection(con_id);
     };
 
-    delete nodes[id];
-    nodes.erase(id);
-
-    for (auto &l : listeners)
-    {
-        l->NodeDeleted(id);
-    };
+    unindexNode(it->second);
+    if (node_deleter != nullptr)
+        node_deleter(it->second);
+    else
+        delete it->second;
+    nodes.erase(it);
+    notifyNodeDeleted(id);
     return true;
 }
 
@@ -263,4 +479,132 @@ void Graph::disableDeletion()
 void Graph::enableDeletion()
 {
     deletion_allowed = true;
-};
\ No newline at end of file
+};
+int Graph::getVersion()
+{
+    return version;
+};
+void Graph::markDirty(Node *node)
+{
+    node->markDirty();
+    notifyNodeChanged(node);
+};
+void Graph::setNodeDeleter(std::function<void(Node *)> deleter)
+{
+    node_deleter = deleter;
+};
+void Graph::beginBatch()
+{
+    batch_depth++;
+};
+void Graph::commit()
+{
+    if (batch_depth == 0 || --batch_depth > 0)
+        return;
+    if (pending.empty())
+        return;
+    // listeners may start a new batch
+    GraphChangeSet changes = std::move(pending);
+    pending.clear();
+    for (auto &l : listeners)
+    {
+        l->GraphChanged(changes);
+    };
+};
+void Graph::notifyNodeAdded(Node *node)
+{
+    if (batch_depth > 0)
+        return pending.nodeAdded(node);
+    for (auto &l : listeners)
+    {
+        l->NodeAdded(node);
+    };
+};
+void Graph::notifyNodeDeleted(int id)
+{
+    if (batch_depth > 0)
+        return pending.nodeDeleted(id);
+    for (auto &l : listeners)
+    {
+        l->NodeDeleted(id);
+    };
+};
+void Graph::notifyConnectionAdded(Connection *connection)
+{
+    if (batch_depth > 0)
+        return pending.connectionAdded(connection);
+    for (auto &l : listeners)
+    {
+        l->ConnectionAdded(connection);
+    };
+};
+void Graph::notifyConnectionDeleted(int id)
+{
+    if (batch_depth > 0)
+        return pending.connectionDeleted(id);
+    for (auto &l : listeners)
+    {
+        l->ConnectionDeleted(id);
+    };
+};
+void Graph::notifyNodeChanged(Node *node)
+{
+    if (batch_depth > 0)
+        return pending.nodeChanged(node);
+    for (auto &l : listeners)
+    {
+        l->NodeChanged(node);
+    };
+};
+
+bool GraphChangeSet::empty() const
+{
+    return added_nodes.empty() && added_connections.empty() && deleted_nodes.empty() &&
+           deleted_connections.empty() && changed_nodes.empty();
+};
+void GraphChangeSet::clear()
+{
+    added_nodes.clear();
+    added_connections.clear();
+    deleted_nodes.clear();
+    deleted_connections.clear();
+    changed_nodes.clear();
+};
+void GraphChangeSet::nodeAdded(Node *node)
+{
+    added_nodes[node->id] = node;
+};
+void GraphChangeSet::nodeDeleted(int id)
+{
+    changed_nodes.erase(id);
+    if (added_nodes.erase(id) == 0)
+        deleted_nodes.push_back(id);
+};
+void GraphChangeSet::connectionAdded(Connection *connection)
+{
+    added_connections[connection->id] = connection;
+};
+void GraphChangeSet::connectionDeleted(int id)
+{
+    if (added_connections.erase(id) == 0)
+        deleted_connections.push_back(id);
+};
+void GraphChangeSet::nodeChanged(Node *node)
+{
+    if (added_nodes.count(node->id) == 0)
+        changed_nodes[node->id] = node;
+};
+
+void GraphListener::GraphChanged(const GraphChangeSet &changes)
+{
+    for (auto id : changes.deleted_connections)
+        ConnectionDeleted(id);
+    for (auto id : changes.deleted_nodes)
+        NodeDeleted(id);
+    for (auto &[_, node] : changes.added_nodes)
+        NodeAdded(node);
+    for (auto &[_, connection] : changes.added_connections)
+        ConnectionAdded(connection);
+    for (auto &[_, node] : changes.changed_nodes)
+        NodeChanged(node);
+};
@@ -5,18 +5,49 @@
 #include "vector"
 #include <stdexcept>
 #include <future>
+#include <functional>
+#include <algorithm>
+#include "Arena.h"
+#include "Trace.h"
 
 class Node;
+class Connection;
 class ConnectionBuilder;
+class Graph;
+
+// the connections attached to a pin, in an array of the graph's storage. Only the graph
+// changes it, a pin that isn't connected holds no array
+class ConnectionList
+{
+public:
+    Connection *const *begin() const { return items; };
+    Connection *const *end() const { return items + count; };
+    Connection *const *data() const { return items; };
+    Connection *operator[](int i) const { return items[i]; };
+    Connection *front() const { return items[0]; };
+    Connection *back() const { return items[count - 1]; };
+    int size() const { return count; };
+    bool empty() const { return count == 0; };
+
+private:
+    friend class Graph;
+    Connection **items = nullptr;
+    int count = 0;
+    int capacity = 0;
+};
+
 class Pin
 {
 public:
     Pin(){};
-    Pin(int _key, std::string _name, int _type, Node *_node);
-    std::string name;
+    Pin(int _key, const std::string &_name, int _type, Node *_node);
+    // interned, pins of the same name share it
+    const char *name;
     int type;
     Node *node;
     int key;
+    // connections attached to this pin, maintained by Graph
+    ConnectionList connections;
     virtual bool isInput() = 0;
     virtual void accept(ConnectionBuilder *factory) = 0;
 };
@@ -24,7 +55,7 @@ class Input : public Pin
 {
 public:
     Input(){};
-    Input(int _key, std::string _name, int _type, Node *_node);
+    Input(int _key, const std::string &_name, int _type, Node *_node);
     bool isInput() override;
     void accept(ConnectionBuilder *factory) override;
 };
@@ -32,30 +63,167 @@ class Output : public Pin
 {
 public:
     Output(){};
-    Output(int _key, std::string _name, int _type, Node *_node);
+    Output(int _key, const std::string &_name, int _type, Node *_node);
     bool isInput() override;
     void accept(ConnectionBuilder *factory) override;
 };
 
-#include <any>
-using Value = std::any;
-class Graph;
+#include <type_traits>
+#include <cassert>
+
+// maps a C++ type to the pin type that carries it, specialised by the application:
+// template <> struct PinTraits<float> { static const int type = ...; };
+template <class T>
+struct PinTraits;
+
+// value passed through a connection, tagged with the pin type it was written for
+class Value
+{
+public:
+    Value() : type(-1), pointer(nullptr){};
+    template <class T>
+    Value(T v) : type(PinTraits<T>::type)
+    {
+        if constexpr (std::is_pointer<T>::value)
+            pointer = (void *)v;
+        else
+            number = v;
+    }
+    template <class T>
+    T get() const
+    {
+        assert(type == PinTraits<T>::type);
+        if constexpr (std::is_pointer<T>::value)
+            return (T)pointer;
+        else
+            return number;
+    }
+    bool empty() const
+    {
+        return type == -1;
+    }
+    int type;
+
+private:
+    union
+    {
+        float number;
+        void *pointer;
+    };
+};
+// pins of one node, stored contiguously and sorted by key
+// pins are added while the node is constructed. A node that adds pins later reserves the
+// room for them up front and appends them with larger keys, so pointers to pins stay valid
+template <class T>
+class PinMap
+{
+public:
+    class iterator
+    {
+    public:
+        iterator(typename std::vector<T>::iterator _it) : it(_it){};
+        T *operator*() { return &*it; };
+        iterator &operator++()
+        {
+            ++it;
+            return *this;
+        };
+        bool operator!=(const iterator &other) const { return it != other.it; };
+
+    private:
+        typename std::vector<T>::iterator it;
+    };
+    // nullptr if the node has no pin with this key
+    T *operator[](int key)
+    {
+        auto it = lowerBound(key);
+        if (it == pins.end() || it->key != key)
+            return nullptr;
+        return &*it;
+    };
+    T *add(T pin)
+    {
+        auto it = lowerBound(pin.key);
+        if (it != pins.end() && it->key == pin.key)
+            *it = std::move(pin);
+        else
+            it = pins.insert(it, std::move(pin));
+        return &*it;
+    };
+    void reserve(int count) { pins.reserve((std::size_t)count); };
+    int size() const { return (int)pins.size(); };
+    iterator begin() { return iterator(pins.begin()); };
+    iterator end() { return iterator(pins.end()); };
+
+private:
+    typename std::vector<T>::iterator lowerBound(int key)
+    {
+        return std::lower_bound(pins.begin(), pins.end(), key, [](const T &pin, int k)
+                                { return pin.key < k; });
+    };
+    std::vector<T> pins;
+};
+
+// non-owning view over contiguous storage of the graph
+template <class T>
+class Span
+{
+public:
+    Span(T *_data, std::size_t _size) : data(_data), length(_size){};
+    T *begin() const { return data; };
+    T *end() const { return data + length; };
+    T &operator[](std::size_t i) const { return data[i]; };
+    std::size_t size() const { return length; };
+    bool empty() const { return length == 0; };
+
+private:
+    T *data;
+    std::size_t length;
+};
+
 class Node
 {
 public:
     Node();
     virtual ~Node();
     std::string header;
-    std::map<int, Output *> outputs = {};
-    std::map<int, Input *> inputs = {};
+    PinMap<Output> outputs;
+    PinMap<Input> inputs;
     int id;
+    int type_id;
     Graph *graph;
-    void virtual trigger(Value &v, [[maybe_unused]] Input *pin);
+    // set when a parameter or a connection of the node changes, cleared after the build
+    bool dirty;
+    void markDirty();
+    // position in the topological order kept by the graph
+    int order_index;
+    // called once per build, after every node connected to the inputs is processed
+    void virtual process();
+    // a node with a variable number of inputs adds them here. inputConnected is called after a
+    // connection to an input was added, requireInput before an input is looked up by its key
+    // while a graph is recovered
+    virtual void inputConnected([[maybe_unused]] Input *pin){};
+    virtual void requireInput([[maybe_unused]] int key){};
+    // nodes are allocated from size class slabs instead of the general heap. What a node
+    // owns, its pin vectors, header and the components of the editor, is still allocated
+    // by the node itself
+    static void *operator new(std::size_t size);
+    static void operator delete(void *pointer, std::size_t size);
 
 protected:
-    //  void virtual trigger(Value &v, [[maybe_unused]] Input *pin);
     void registerInput(int key, const std::string &name, int type);
     void registerOutput(int key, const std::string &name, int type);
+    Value *getInputValue(int key);
+    void setOutputValue(int key, Value value);
+    template <class T>
+    bool getInput(int key, T &result)
+    {
+        Value *value = getInputValue(key);
+        if (value == nullptr || value->type != PinTraits<T>::type)
+            return false;
+        result = value->get<T>();
+        return true;
+    }
 };
 
 class Connection
@@ -70,6 +238,8 @@ public:
     int id;
     Output *pin_from;
     Input *pin_to;
+    // last value written by the node on the output side
+    Value value;
 
     void setAsPin(Pin *pin);
 };
@@ -79,11 +249,29 @@ class ConnectionBuilder
 public:
     ConnectionBuilder();
     void addPin(Pin *pin);
-    Connection *build();
+    Connection *build(ObjectPool<Connection> &pool);
     Input *input;
     Output *output;
 };
 
+// changes made during one batch, an object added and removed within the batch is not listed
+class GraphChangeSet
+{
+public:
+    std::map<int, Node *> added_nodes;
+    std::map<int, Connection *> added_connections;
+    std::vector<int> deleted_nodes;
+    std::vector<int> deleted_connections;
+    std::map<int, Node *> changed_nodes;
+    bool empty() const;
+    void clear();
+    void nodeAdded(Node *node);
+    void nodeDeleted(int id);
+    void connectionAdded(Connection *connection);
+    void connectionDeleted(int id);
+    void nodeChanged(Node *node);
+};
+
 class GraphListener
 {
 public:
@@ -91,34 +279,121 @@ public:
     virtual void NodeDeleted(int id) = 0;
     virtual void ConnectionAdded(Connection *connection) = 0;
     virtual void ConnectionDeleted(int id) = 0;
-    virtual void message(std::string text) = 0;
+    virtual void NodeChanged([[maybe_unused]] Node *node){};
+    // called once per committed batch, by default replays the changes through the calls above
+    virtual void GraphChanged(const GraphChangeSet &changes);
 };
 
 class Graph
 {
 public:
     Graph();
-    std::unordered_map<int, Node *> getNodes();
-    std::unordered_map<int, Connection *> getConnections();
+    // views of the internal storage, valid until the graph is changed
+    const std::unordered_map<int, Node *> &getNodes() const;
+    const std::unordered_map<int, Connection *> &getConnections() const;
+    Span<Connection *const> getPinConnections(Pin *pin) const;
+    // every node comes after all nodes connected to its inputs, may contain nullptr for deleted nodes
+    Span<Node *const> getOrder() const;
+    template <class F>
+    void forEachNode(F visit) const
+    {
+        for (auto &[_, n] : nodes)
+            visit(n);
+    };
+    template <class F>
+    void forEachConnection(F visit) const
+    {
+        for (auto &[_, c] : connections)
+            visit(c);
+    };
+    // visits the connections of the outputs first, then of the inputs
+    template <class F>
+    void forEachConnectionOfNode(int id, F visit) const
+    {
+        auto it = nodes.find(id);
+        if (it == nodes.end())
+            return;
+        for (auto pin : it->second->outputs)
+            for (auto c : pin->connections)
+                visit(c);
+        for (auto pin : it->second->inputs)
+            for (auto c : pin->connections)
+                visit(c);
+    };
+    template <class F>
+    void forEachInputOfOutput(Output *pin, F visit) const
+    {
+        for (auto c : pin->connections)
+            visit(c->pin_to);
+    };
     virtual ~Graph();
     void addNode(Node *node);
     Connection *addConnection(Pin *pin1, Pin *pin2);
     std::vector<int> getConnectionsOfNode(int id);
     std::vector<int> getInputConnectionsOfNode(int id);
+    const std::unordered_map<int, Node *> &getNodesOfType(int type_id);
     void deleteConnection(int id);
     bool deleteNode(int id);
     void registerListener(GraphListener *listener);
     void triggerPin(Output *pin, Value &Value);
-    std::vector<Input *> getInputsOfOutput(Output *pin);
     int getOutputsOfInputSize(Input *pin);
     void disableDeletion();
     void enableDeletion();
+    // listeners are told about the changes made until the matching commit at once, batches can be nested
+    void beginBatch();
+    void commit();
+    // marks the node dirty and tells the listeners that it was changed
+    void markDirty(Node *node);
+    // deleteNode hands the removed nodes to the deleter instead of deleting them
+    void setNodeDeleter(std::function<void(Node *)> deleter);
+    // changes whenever nodes or connections are added or removed
+    int getVersion();
 
 protected:
     std::unordered_map<int, Node *> nodes;
     std::unordered_map<int, Connection *> connections;
+    std::unordered_map<int, std::unordered_map<int, Node *>> nodes_by_type;
+    std::vector<Node *> order;
+    int order_holes;
+    void indexNode(Node *node);
+    void unindexNode(Node *node);
+    void linkConnection(Connection *connection);
+    void unlinkConnection(Connection *connection);
+    // the connection lists of the pins live in list_storage
+    void appendConnection(Pin *pin, Connection *connection);
+    void removeConnection(Pin *pin, Connection *connection);
+    void reserveConnections(Pin *pin, int capacity);
+    void releaseConnections(Pin *pin);
+    void clear();
+    Connection *createConnection(Pin *pin1, Pin *pin2);
+    // moves nodes so the connection keeps the order topological, throws std::invalid_argument on a cycle
+    void orderConnection(Connection *connection);
+    ObjectPool<Connection> connection_pool;
+    PointerArrayPool list_storage;
     int getId();
     int auto_increment;
+    int version;
     std::vector<GraphListener *> listeners;
     bool deletion_allowed;
+    std::function<void(Node *)> node_deleter;
+    void notifyNodeAdded(Node *node);
+    void notifyNodeDeleted(int id);
+    void notifyConnectionAdded(Connection *connection);
+    void notifyConnectionDeleted(int id);
+    void notifyNodeChanged(Node *node);
+    int batch_depth;
+    GraphChangeSet pending;
+};
+
+// opens a batch for the lifetime of the object
+class GraphBatch
+{
+public:
+    GraphBatch(Graph *_graph) : graph(_graph) { graph->beginBatch(); };
+    ~GraphBatch() { graph->commit(); };
+    GraphBatch(const GraphBatch &) = delete;
+    GraphBatch &operator=(const GraphBatch &) = delete;
+
+private:
+    Graph *graph;
 };
\ No newline at end of file
@@ -0,0 +1,77 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+// highest level compiled in, 0 removes every trace call
+#ifndef NODEGRAPH_TRACE_LEVEL
+#define NODEGRAPH_TRACE_LEVEL 0
+#endif
+
+enum class TraceLevel
+{
+    Off = 0,
+    Build = 1,      // plan execution and processed nodes
+    Connection = 2, // every value written to a connection
+};
+
+enum class TraceEvent : std::uint8_t
+{
+    BuildStarted,
+    BuildFinished,
+    NodeProcessed,
+    ConnectionTriggered,
+};
+
+struct TraceRecord
+{
+    std::int64_t time_ns;
+    TraceEvent event;
+    int id;
+};
+
+// fixed ring of the latest records, only written from the message thread
+class Tracer
+{
+public:
+    static const int capacity = 4096;
+    static Tracer &getInstance()
+    {
+        static Tracer instance;
+        return instance;
+    };
+    // runtime level, records above it are dropped
+    void setLevel(TraceLevel _level) { level = _level; };
+    bool enabled(TraceLevel at) const { return at <= level; };
+    void record(TraceEvent event, int id)
+    {
+        auto now = std::chrono::steady_clock::now().time_since_epoch();
+        records[head % capacity] = {std::chrono::duration_cast<std::chrono::nanoseconds>(now).count(), event, id};
+        head++;
+    };
+    // visits the stored records from the oldest to the newest
+    template <class F>
+    void forEach(F visit) const
+    {
+        std::uint64_t first = head > capacity ? head - capacity : 0;
+        for (std::uint64_t i = first; i < head; i++)
+            visit(records[i % capacity]);
+    };
+    void clear() { head = 0; };
+
+private:
+    Tracer() : level(TraceLevel::Off), head(0){};
+    TraceLevel level;
+    std::uint64_t head;
+    std::array<TraceRecord, capacity> records;
+};
+
+#define NODEGRAPH_TRACE(at, event, id)                                \
+    do                                                                \
+    {                                                                 \
+        if constexpr ((int)(at) <= NODEGRAPH_TRACE_LEVEL)             \
+        {                                                             \
+            if (Tracer::getInstance().enabled(at))                    \
+                Tracer::getInstance().record(event, id);              \
+        }                                                             \
+    } while (false)
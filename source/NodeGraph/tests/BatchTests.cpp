@@ -0,0 +1,112 @@
+#include "TestGraph.h"
+
+// records every call, the replay of a change set by the default GraphChanged included
+class RecordingListener : public GraphListener
+{
+public:
+    void NodeAdded(Node *node) override { calls.push_back("node+" + std::to_string(node->id)); }
+    void NodeDeleted(int id) override { calls.push_back("node-" + std::to_string(id)); }
+    void ConnectionAdded(Connection *connection) override { calls.push_back("connection+" + std::to_string(connection->id)); }
+    void ConnectionDeleted(int id) override { calls.push_back("connection-" + std::to_string(id)); }
+    void NodeChanged(Node *node) override { calls.push_back("changed" + std::to_string(node->id)); }
+    void GraphChanged(const GraphChangeSet &changes) override
+    {
+        batches++;
+        last = changes;
+        GraphListener::GraphChanged(changes);
+    }
+    std::vector<std::string> calls;
+    int batches = 0;
+    GraphChangeSet last;
+};
+
+// outside a batch every change is reported at once
+static void changesOutsideBatches()
+{
+    Graph graph;
+    RecordingListener listener;
+    graph.registerListener(&listener);
+    auto a = new TestNode(), b = new TestNode();
+    graph.addNode(a);
+    graph.addNode(b);
+    auto c = graph.addConnection(a->out(), b->in());
+    graph.markDirty(a);
+    CHECK(listener.batches == 0);
+    CHECK(listener.calls == (std::vector<std::string>{"node+1", "node+2", "connection+" + std::to_string(c->id), "changed1"}));
+}
+
+// nothing is reported until the outermost batch commits, then once
+static void nestedBatchesCommitOnce()
+{
+    Graph graph;
+    RecordingListener listener;
+    graph.registerListener(&listener);
+    {
+        GraphBatch outer(&graph);
+        graph.addNode(new TestNode());
+        {
+            GraphBatch inner(&graph);
+            graph.addNode(new TestNode());
+        }
+        CHECK(listener.calls.empty());
+        CHECK(listener.batches == 0);
+    }
+    CHECK(listener.batches == 1);
+    CHECK(listener.last.added_nodes.size() == 2);
+    // an empty batch is not reported
+    {
+        GraphBatch empty(&graph);
+    }
+    CHECK(listener.batches == 1);
+}
+
+// what is added and removed again within a batch is left out, changes to added nodes too
+static void changesAreCoalesced()
+{
+    Graph graph;
+    RecordingListener listener;
+    auto kept = new TestNode(), removed = new TestNode(), changed = new TestNode();
+    for (auto n : {kept, removed, changed})
+        graph.addNode(n);
+    auto old_connection = graph.addConnection(kept->out(), removed->in());
+    int old_connection_id = old_connection->id;
+    int removed_id = removed->id;
+    graph.registerListener(&listener);
+    {
+        GraphBatch batch(&graph);
+        auto temporary = new TestNode();
+        graph.addNode(temporary);
+        graph.markDirty(temporary);
+        auto connection = graph.addConnection(kept->out(), temporary->in());
+        graph.deleteConnection(connection->id);
+        graph.deleteNode(temporary->id);
+
+        auto added = new TestNode();
+        graph.addNode(added);
+        graph.markDirty(added);
+        graph.markDirty(changed);
+        graph.markDirty(removed);
+        graph.deleteNode(removed->id);
+        graph.addConnection(changed->out(), added->in());
+    }
+    CHECK(listener.batches == 1);
+    auto &changes = listener.last;
+    CHECK(changes.added_nodes.size() == 1);
+    CHECK(changes.added_connections.size() == 1);
+    CHECK(changes.deleted_nodes == std::vector<int>{removed_id});
+    CHECK(changes.deleted_connections == std::vector<int>{old_connection_id});
+    CHECK(changes.changed_nodes.size() == 1 && changes.changed_nodes.count(changed->id) == 1);
+    // replayed deletions first, then additions, then changes
+    CHECK(listener.calls.size() == 5);
+    CHECK(listener.calls.front() == "connection-" + std::to_string(old_connection_id));
+    CHECK(listener.calls[1] == "node-" + std::to_string(removed_id));
+    CHECK(listener.calls.back() == "changed" + std::to_string(changed->id));
+}
+
+int main()
+{
+    changesOutsideBatches();
+    nestedBatchesCommitOnce();
+    changesAreCoalesced();
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include <iostream>
+
+// A failed check is printed and counted, the test returns the count from main
+inline int failures = 0;
+
+#define CHECK(condition)                                                                   \
+    do                                                                                     \
+    {                                                                                      \
+        if (!(condition))                                                                  \
+        {                                                                                  \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed\n"; \
+            failures++;                                                                    \
+        }                                                                                  \
+    } while (false)
@@ -0,0 +1,137 @@
+#include "TestGraph.h"
+#include <random>
+#include <set>
+
+// nodes added in the reverse of their data flow are moved when they are connected
+static void connectingMovesNodes()
+{
+    Graph graph;
+    auto c = new TestNode(), b = new TestNode(), a = new TestNode();
+    graph.addNode(c);
+    graph.addNode(b);
+    graph.addNode(a);
+    graph.addConnection(b->out(), c->in());
+    graph.addConnection(a->out(), b->in());
+    CHECK(a->order_index < b->order_index);
+    CHECK(b->order_index < c->order_index);
+    CHECK(isTopological(graph));
+}
+
+// a rejected connection leaves the graph as it was
+static void cyclesAreRejected()
+{
+    Graph graph;
+    auto a = new TestNode(), b = new TestNode(), c = new TestNode();
+    graph.addNode(a);
+    graph.addNode(b);
+    graph.addNode(c);
+    graph.addConnection(a->out(), b->in());
+    graph.addConnection(b->out(), c->in());
+    int version = graph.getVersion();
+    for (auto [from, to] : {std::pair<TestNode *, TestNode *>{c, a}, {b, a}, {a, a}})
+    {
+        bool thrown = false;
+        try
+        {
+            graph.addConnection(from->out(), to->in());
+        }
+        catch (const std::invalid_argument &e)
+        {
+            thrown = std::string(e.what()) == "Connection creates a cycle";
+        }
+        CHECK(thrown);
+    }
+    CHECK(graph.getConnections().size() == 2);
+    CHECK(a->in()->connections.empty());
+    CHECK(c->out()->connections.empty());
+    CHECK(graph.getVersion() == version);
+    CHECK(isTopological(graph));
+}
+
+// random connections, each one is accepted exactly when it doesn't close a path
+static void randomGraphsStayOrdered()
+{
+    std::mt19937 random(7);
+    for (int round = 0; round < 20; round++)
+    {
+        Graph graph;
+        const int size = 40;
+        std::vector<TestNode *> nodes;
+        for (int i = 0; i < size; i++)
+        {
+            nodes.push_back(new TestNode(size, 1));
+            graph.addNode(nodes.back());
+        }
+        std::vector<std::set<int>> edges(size);
+        auto reaches = [&](int from, int to)
+        {
+            std::vector<int> stack = {from};
+            std::vector<bool> seen(size);
+            while (!stack.empty())
+            {
+                int n = stack.back();
+                stack.pop_back();
+                if (n == to)
+                    return true;
+                for (int next : edges[n])
+                {
+                    if (!seen[next])
+                    {
+                        seen[next] = true;
+                        stack.push_back(next);
+                    }
+                }
+            }
+            return false;
+        };
+        for (int i = 0; i < 200; i++)
+        {
+            int from = (int)(random() % size), to = (int)(random() % size);
+            if (edges[from].count(to))
+                continue;
+            bool accepted = true;
+            try
+            {
+                graph.addConnection(nodes[from]->out(), nodes[to]->in(from));
+            }
+            catch (const std::invalid_argument &)
+            {
+                accepted = false;
+            }
+            CHECK(accepted == !reaches(to, from));
+            if (accepted)
+                edges[from].insert(to);
+        }
+        CHECK(isTopological(graph));
+    }
+}
+
+// deleted nodes leave holes in the order that are skipped and eventually compacted
+static void deletingKeepsOrder()
+{
+    Graph graph;
+    std::vector<TestNode *> nodes;
+    for (int i = 0; i < 10; i++)
+    {
+        nodes.push_back(new TestNode());
+        graph.addNode(nodes.back());
+    }
+    for (int i = 9; i > 0; i--)
+        graph.addConnection(nodes[i]->out(), nodes[i - 1]->in());
+    for (int i = 0; i < 10; i += 2)
+        graph.deleteNode(nodes[i]->id);
+    CHECK(isTopological(graph));
+    int present = 0;
+    for (auto n : graph.getOrder())
+        present += n != nullptr;
+    CHECK(present == 5);
+}
+
+int main()
+{
+    connectingMovesNodes();
+    cyclesAreRejected();
+    randomGraphsStayOrdered();
+    deletingKeepsOrder();
+    return failures == 0 ? 0 : 1;
+}
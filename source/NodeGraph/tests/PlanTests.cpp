@@ -0,0 +1,95 @@
+#include "TestGraph.h"
+#include "GraphCompiler.h"
+
+static float valueOf(Output *pin)
+{
+    return pin->connections.empty() ? -1 : pin->connections.front()->value.get<float>();
+}
+
+// the first build processes every node, later ones only what changed and what follows it
+static void onlyDirtyNodesAreProcessed()
+{
+    Graph graph;
+    auto a = new TestNode(), b = new TestNode(), c = new TestNode(), d = new TestNode(), sink = new TestNode();
+    for (auto n : {c, sink, a, d, b})
+        graph.addNode(n);
+    graph.addConnection(a->out(), b->in());
+    graph.addConnection(b->out(), c->in());
+    graph.addConnection(c->out(), sink->in());
+    GraphCompiler compiler;
+    auto plan = compiler.compile(&graph);
+    CHECK(plan.order.size() == 5);
+
+    plan.execute();
+    for (auto n : {a, b, c, d, sink})
+        CHECK(n->processed == 1);
+    CHECK(valueOf(c->out()) == 3);
+
+    plan.execute();
+    for (auto n : {a, b, c, d, sink})
+        CHECK(n->processed == 1);
+
+    graph.markDirty(b);
+    plan.execute();
+    CHECK(a->processed == 1);
+    CHECK(b->processed == 2);
+    CHECK(c->processed == 2);
+    CHECK(sink->processed == 2);
+    CHECK(d->processed == 1);
+    for (auto n : {a, b, c, d, sink})
+        CHECK(!n->dirty);
+}
+
+// propagate marks the downstream nodes without processing or clearing anything
+static void propagateOnlyMarks()
+{
+    Graph graph;
+    auto a = new TestNode(), b = new TestNode(2, 1), c = new TestNode(), d = new TestNode(), e = new TestNode();
+    for (auto n : {a, b, c, d, e})
+        graph.addNode(n);
+    graph.addConnection(a->out(), c->in());
+    graph.addConnection(c->out(), b->in(0));
+    graph.addConnection(d->out(), b->in(1));
+    auto plan = GraphCompiler().compile(&graph);
+    plan.execute();
+
+    c->markDirty();
+    plan.propagate();
+    CHECK(!a->dirty);
+    CHECK(c->dirty);
+    CHECK(b->dirty);
+    CHECK(!d->dirty);
+    CHECK(!e->dirty);
+    CHECK(c->processed == 1 && b->processed == 1);
+}
+
+// in a diamond every node is processed once, after both of its inputs
+static void diamondIsProcessedInOrder()
+{
+    Graph graph;
+    auto top = new TestNode(1, 2), left = new TestNode(), right = new TestNode(), bottom = new TestNode(2, 1);
+    for (auto n : {bottom, right, left, top})
+        graph.addNode(n);
+    graph.addConnection(top->out(0), left->in());
+    graph.addConnection(top->out(1), right->in());
+    graph.addConnection(left->out(), bottom->in(0));
+    graph.addConnection(right->out(), bottom->in(1));
+    auto plan = GraphCompiler().compile(&graph);
+    plan.execute();
+    graph.markDirty(top);
+    plan.execute();
+    for (auto n : {top, left, right, bottom})
+        CHECK(n->processed == 2);
+    CHECK(top->processed_at < left->processed_at);
+    CHECK(top->processed_at < right->processed_at);
+    CHECK(left->processed_at < bottom->processed_at);
+    CHECK(right->processed_at < bottom->processed_at);
+}
+
+int main()
+{
+    onlyDirtyNodesAreProcessed();
+    propagateOnlyMarks();
+    diamondIsProcessedInOrder();
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,177 @@
+#include "TestGraph.h"
+#include <set>
+
+class TypedNode : public TestNode
+{
+public:
+    TypedNode(int type)
+    {
+        type_id = type;
+    }
+};
+
+// the views read the graph's own storage and follow it as it changes
+static void pinViewsFollowConnections()
+{
+    Graph graph;
+    auto a = new TestNode(), b = new TestNode(), c = new TestNode();
+    for (auto n : {a, b, c})
+        graph.addNode(n);
+    auto ab = graph.addConnection(a->out(), b->in());
+    auto ac = graph.addConnection(a->out(), c->in());
+    auto view = graph.getPinConnections(a->out());
+    CHECK(view.size() == 2);
+    CHECK(view[0] == ab && view[1] == ac);
+    CHECK(graph.getPinConnections(b->in()).size() == 1);
+
+    graph.deleteConnection(ab->id);
+    view = graph.getPinConnections(a->out());
+    CHECK(view.size() == 1 && view[0] == ac);
+    CHECK(graph.getPinConnections(b->in()).empty());
+
+    std::set<Input *> inputs;
+    graph.forEachInputOfOutput(a->out(), [&](Input *pin)
+                               { inputs.insert(pin); });
+    CHECK(inputs == std::set<Input *>{c->in()});
+}
+
+// outputs first, then inputs, and the same connections as the id list
+static void connectionsOfNode()
+{
+    Graph graph;
+    auto a = new TestNode(), b = new TestNode(), c = new TestNode();
+    for (auto n : {a, b, c})
+        graph.addNode(n);
+    auto in = graph.addConnection(a->out(), b->in());
+    auto out = graph.addConnection(b->out(), c->in());
+    std::vector<Connection *> visited;
+    graph.forEachConnectionOfNode(b->id, [&](Connection *connection)
+                                  { visited.push_back(connection); });
+    CHECK(visited == (std::vector<Connection *>{out, in}));
+    CHECK(graph.getConnectionsOfNode(b->id) == (std::vector<int>{out->id, in->id}));
+    CHECK(graph.getInputConnectionsOfNode(b->id) == std::vector<int>{in->id});
+    CHECK(graph.getConnectionsOfNode(12345).empty());
+
+    graph.deleteNode(b->id);
+    CHECK(graph.getConnections().empty());
+    CHECK(a->out()->connections.empty());
+    CHECK(c->in()->connections.empty());
+}
+
+// lists grow past their first arrays and keep their order when a connection goes away
+static void listsKeepOrder()
+{
+    Graph graph;
+    auto a = new TestNode();
+    graph.addNode(a);
+    std::vector<Connection *> added;
+    for (int i = 0; i < 9; i++)
+    {
+        auto n = new TestNode();
+        graph.addNode(n);
+        added.push_back(graph.addConnection(a->out(), n->in()));
+    }
+    graph.deleteConnection(added[3]->id);
+    added.erase(added.begin() + 3);
+    auto &list = a->out()->connections;
+    CHECK(std::vector<Connection *>(list.begin(), list.end()) == added);
+}
+
+// nodes the deleter keeps alive don't point into the graph's storage once it is gone
+static void deleterKeepsEmptyPins()
+{
+    std::vector<Node *> kept;
+    TestNode *a, *b;
+    {
+        Graph graph;
+        graph.setNodeDeleter([&](Node *node)
+                             { kept.push_back(node); });
+        a = new TestNode(), b = new TestNode();
+        graph.addNode(a);
+        graph.addNode(b);
+        graph.addConnection(a->out(), b->in());
+    }
+    CHECK(kept.size() == 2);
+    CHECK(a->out()->connections.empty() && a->out()->connections.data() == nullptr);
+    CHECK(b->in()->connections.empty() && b->in()->connections.data() == nullptr);
+    for (auto n : kept)
+        delete n;
+}
+
+// adds an input whenever its last one is connected
+class GrowingNode : public TestNode
+{
+public:
+    GrowingNode() : TestNode(1, 1)
+    {
+        inputs.reserve(8);
+    }
+    void inputConnected(Input *pin) override
+    {
+        if (pin->key == inputs.size() - 1 && inputs.size() < 8)
+            registerInput(inputs.size(), "in", PinTraits<float>::type);
+    }
+};
+
+class ChangeListener : public GraphListener
+{
+public:
+    void NodeAdded(Node *) override {}
+    void NodeDeleted(int) override {}
+    void ConnectionAdded(Connection *) override {}
+    void ConnectionDeleted(int) override {}
+    void NodeChanged(Node *node) override { changed.push_back(node); }
+    std::vector<Node *> changed;
+};
+
+// the pins a node adds don't move the ones connected before, and the listeners hear of them
+static void growingInputs()
+{
+    Graph graph;
+    ChangeListener listener;
+    graph.registerListener(&listener);
+    auto a = new TestNode(), b = new TestNode();
+    auto mix = new GrowingNode();
+    for (auto n : {(Node *)a, (Node *)b, (Node *)mix})
+        graph.addNode(n);
+    Input *first = mix->in(0);
+    graph.addConnection(a->out(), first);
+    CHECK(mix->inputs.size() == 2);
+    CHECK(mix->in(0) == first);
+    CHECK(listener.changed == std::vector<Node *>{mix});
+    graph.addConnection(b->out(), mix->in(1));
+    CHECK(mix->inputs.size() == 3);
+    CHECK(mix->in(0) == first && first->connections.size() == 1);
+    // an input that isn't the last adds nothing
+    graph.addConnection(b->out(), mix->in(0));
+    CHECK(mix->inputs.size() == 3 && listener.changed.size() == 2);
+}
+
+static void nodesByType()
+{
+    Graph graph;
+    auto x1 = new TypedNode(1), x2 = new TypedNode(1), y = new TypedNode(2);
+    for (auto n : {x1, x2, y})
+        graph.addNode(n);
+    CHECK(graph.getNodesOfType(1).size() == 2);
+    CHECK(graph.getNodesOfType(2).size() == 1);
+    CHECK(graph.getNodesOfType(3).empty());
+    graph.deleteNode(x1->id);
+    auto &ones = graph.getNodesOfType(1);
+    CHECK(ones.size() == 1 && ones.count(x2->id) == 1);
+    int count = 0;
+    graph.forEachNode([&](Node *)
+                      { count++; });
+    CHECK(count == 2);
+}
+
+int main()
+{
+    pinViewsFollowConnections();
+    connectionsOfNode();
+    listsKeepOrder();
+    deleterKeepsEmptyPins();
+    growingInputs();
+    nodesByType();
+    return failures == 0 ? 0 : 1;
+}
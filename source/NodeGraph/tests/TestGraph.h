@@ -0,0 +1,64 @@
+#pragma once
+#include "Check.h"
+#include "NodeGraph.h"
+
+template <>
+struct PinTraits<float>
+{
+    static const int type = 0;
+};
+template <>
+struct PinTraits<int *>
+{
+    static const int type = 1;
+};
+
+// counts the nodes processed so far, for the order they were processed in
+inline int process_clock = 0;
+
+// a node with numbered float pins that counts how often it is processed, its outputs
+// carry one more than the sum of its inputs
+class TestNode : public Node
+{
+public:
+    TestNode(int num_inputs = 1, int num_outputs = 1)
+    {
+        for (int i = 0; i < num_inputs; i++)
+            registerInput(i, "in", PinTraits<float>::type);
+        for (int i = 0; i < num_outputs; i++)
+            registerOutput(i, "out", PinTraits<float>::type);
+    }
+    void process() override
+    {
+        processed++;
+        processed_at = ++process_clock;
+        float sum = 0;
+        for (auto pin : inputs)
+        {
+            float v;
+            if (getInput(pin->key, v))
+                sum += v;
+        }
+        for (auto pin : outputs)
+            setOutputValue(pin->key, Value(sum + 1));
+    }
+    Input *in(int key = 0) { return inputs[key]; }
+    Output *out(int key = 0) { return outputs[key]; }
+    int processed = 0;
+    int processed_at = 0;
+};
+
+// every connection goes forward in the order of the graph and the order indices match
+inline bool isTopological(const Graph &graph)
+{
+    auto order = graph.getOrder();
+    for (std::size_t i = 0; i < order.size(); i++)
+    {
+        if (order[i] != nullptr && order[i]->order_index != (int)i)
+            return false;
+    }
+    bool forward = true;
+    graph.forEachConnection([&](Connection *c)
+                            { forward = forward && c->pin_from->node->order_index < c->pin_to->node->order_index; });
+    return forward;
+}
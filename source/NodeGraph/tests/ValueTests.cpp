@@ -0,0 +1,59 @@
+#include "TestGraph.h"
+#include <type_traits>
+
+// a node that reads its input as a float and as a pointer
+class ReaderNode : public TestNode
+{
+public:
+    bool readFloat(float &v) { return getInput(0, v); }
+    bool readPointer(int *&v) { return getInput(0, v); }
+};
+
+static void valuesKeepTheirType()
+{
+    Value empty;
+    CHECK(empty.empty());
+    CHECK(empty.type == -1);
+
+    Value number(2.5f);
+    CHECK(!number.empty());
+    CHECK(number.type == PinTraits<float>::type);
+    CHECK(number.get<float>() == 2.5f);
+
+    int target = 3;
+    Value pointer(&target);
+    CHECK(pointer.type == PinTraits<int *>::type);
+    CHECK(pointer.get<int *>() == &target);
+
+    Value copy = number;
+    CHECK(copy.get<float>() == 2.5f);
+    // passed by value through every connection, nothing is allocated
+    CHECK(std::is_trivially_copyable<Value>::value);
+    CHECK(sizeof(Value) <= 2 * sizeof(void *));
+}
+
+// an input reads nothing until the node before it was processed, and only as its own type
+static void inputsReadTypedValues()
+{
+    Graph graph;
+    auto source = new TestNode(0, 1);
+    auto reader = new ReaderNode();
+    graph.addNode(source);
+    graph.addNode(reader);
+    graph.addConnection(source->out(), reader->in());
+    float v = 0;
+    int *p = nullptr;
+    CHECK(!reader->readFloat(v));
+    source->process();
+    CHECK(reader->readFloat(v));
+    CHECK(v == 1);
+    CHECK(!reader->readPointer(p));
+    CHECK(p == nullptr);
+}
+
+int main()
+{
+    valuesKeepTheirType();
+    inputsReadTypedValues();
+    return failures == 0 ? 0 : 1;
+}